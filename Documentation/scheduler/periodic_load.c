@@ -0,0 +1,206 @@
+/* periodic_load.c
+ *
+ * Synthetic periodic workload for evaluating wake-up placement: a number
+ * of threads each wake up every period, run for a short while and sleep
+ * again, like audio, sensor or UI ticks do. Reports the wake-up latency
+ * seen by the threads, how their wake-ups were spread over cpus and how
+ * many times each cpu left idle while the test ran.
+ *
+ * Compile with
+ *	gcc -O2 -pthread periodic_load.c -o periodic_load
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#define MAX_CPUS	32
+#define MAX_STATES	16
+
+static int nr_threads = 2;
+static long period_us = 10000;
+static long run_us = 500;
+static int duration_s = 10;
+static int nr_cpus;
+
+struct thread_stats {
+	pthread_t tid;
+	unsigned long wakeups;
+	unsigned long long lat_sum_ns;
+	unsigned long long lat_max_ns;
+	unsigned long cpu[MAX_CPUS];
+};
+
+static unsigned long long ts_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static void ts_add_ns(struct timespec *ts, long ns)
+{
+	ts->tv_nsec += ns;
+	while (ts->tv_nsec >= 1000000000L) {
+		ts->tv_nsec -= 1000000000L;
+		ts->tv_sec++;
+	}
+}
+
+/*
+ * Number of idle state entries on @cpu, i.e. the number of times it went
+ * idle and was woken again. Returns 0 without cpuidle.
+ */
+static unsigned long long cpu_idle_entries(int cpu)
+{
+	unsigned long long usage, sum = 0;
+	char path[128];
+	FILE *f;
+	int i;
+
+	for (i = 0; i < MAX_STATES; i++) {
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu%d/cpuidle/state%d/usage",
+			 cpu, i);
+		f = fopen(path, "r");
+		if (!f)
+			break;
+		if (fscanf(f, "%llu", &usage) == 1)
+			sum += usage;
+		fclose(f);
+	}
+
+	return sum;
+}
+
+static void *periodic_thread(void *arg)
+{
+	struct thread_stats *s = arg;
+	struct timespec next, now, end;
+	unsigned long long lat;
+	int cpu;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	end = next;
+	end.tv_sec += duration_s;
+
+	for (;;) {
+		ts_add_ns(&next, period_us * 1000);
+		if (ts_ns(&next) >= ts_ns(&end))
+			break;
+
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		lat = ts_ns(&now) - ts_ns(&next);
+		s->wakeups++;
+		s->lat_sum_ns += lat;
+		if (lat > s->lat_max_ns)
+			s->lat_max_ns = lat;
+
+		cpu = sched_getcpu();
+		if (cpu >= 0 && cpu < MAX_CPUS)
+			s->cpu[cpu]++;
+
+		/* busy loop for run_us */
+		do {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+		} while (ts_ns(&now) < ts_ns(&next) + run_us * 1000);
+	}
+
+	return NULL;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-t threads] [-p period_us] [-r run_us] "
+		"[-d seconds]\n", name);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long long idle_before[MAX_CPUS], idle_total = 0;
+	unsigned long long lat_sum = 0, lat_max = 0;
+	unsigned long wakeups = 0, on_cpu;
+	struct thread_stats *stats;
+	int c, i, cpu;
+
+	while ((c = getopt(argc, argv, "t:p:r:d:")) != -1) {
+		switch (c) {
+		case 't':
+			nr_threads = atoi(optarg);
+			break;
+		case 'p':
+			period_us = atol(optarg);
+			break;
+		case 'r':
+			run_us = atol(optarg);
+			break;
+		case 'd':
+			duration_s = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (nr_threads < 1 || period_us <= 0 || run_us < 0 ||
+	    run_us >= period_us || duration_s < 1)
+		usage(argv[0]);
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (nr_cpus > MAX_CPUS)
+		nr_cpus = MAX_CPUS;
+
+	stats = calloc(nr_threads, sizeof(*stats));
+	if (!stats) {
+		perror("calloc");
+		return 1;
+	}
+
+	for (cpu = 0; cpu < nr_cpus; cpu++)
+		idle_before[cpu] = cpu_idle_entries(cpu);
+
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&stats[i].tid, NULL, periodic_thread,
+				   &stats[i])) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(stats[i].tid, NULL);
+
+	printf("threads %d period %ldus run %ldus duration %ds\n",
+	       nr_threads, period_us, run_us, duration_s);
+
+	printf("cpu   wakeups-from-idle   task-wakeups\n");
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		unsigned long long idle;
+
+		idle = cpu_idle_entries(cpu) - idle_before[cpu];
+		idle_total += idle;
+
+		on_cpu = 0;
+		for (i = 0; i < nr_threads; i++)
+			on_cpu += stats[i].cpu[cpu];
+		printf("%3d   %17llu   %12lu\n", cpu, idle, on_cpu);
+	}
+	printf("total %17llu\n", idle_total);
+
+	for (i = 0; i < nr_threads; i++) {
+		wakeups += stats[i].wakeups;
+		lat_sum += stats[i].lat_sum_ns;
+		if (stats[i].lat_max_ns > lat_max)
+			lat_max = stats[i].lat_max_ns;
+	}
+	printf("wake-up latency: avg %lluus max %lluus over %lu wake-ups\n",
+	       wakeups ? lat_sum / wakeups / 1000 : 0, lat_max / 1000,
+	       wakeups);
+
+	free(stats);
+	return 0;
+}
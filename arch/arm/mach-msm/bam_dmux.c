@@ -115,6 +115,7 @@ struct rx_pkt_info {
 #define A2_PHYS_SIZE		0x2000
 #define BUFFER_SIZE		2048
 #define NUM_BUFFERS		32
+#define RX_POOL_LEN		8
 static struct delayed_work bam_init_work;
 static struct sps_bam_props a2_props;
 static struct sps_pipe *bam_tx_pipe;
@@ -148,6 +149,9 @@ static DEFINE_MUTEX(bam_mux_lock);
 static DECLARE_WORK(rx_timer_work, rx_timer_work_func);
 
 static struct workqueue_struct *bam_mux_rx_workqueue;
+
+/* rx buffers freed by the mux itself are reused by queue_rx() */
+static struct sk_buff_pool bam_rx_skb_pool;
 static struct workqueue_struct *bam_mux_tx_workqueue;
 
 #define bam_ch_is_open(x)						\
@@ -170,7 +174,7 @@ static void queue_rx(void)
 
 	INIT_WORK(&info->work, handle_bam_mux_cmd);
 
-	info->skb = __dev_alloc_skb(BUFFER_SIZE, GFP_KERNEL);
+	info->skb = skb_pool_alloc(&bam_rx_skb_pool, BUFFER_SIZE, GFP_KERNEL);
 	ptr = skb_put(info->skb, BUFFER_SIZE);
 
 	mutex_lock(&bam_rx_pool_lock);
@@ -200,7 +204,7 @@ static void bam_mux_process_data(struct sk_buff *rx_skb)
 		bam_ch[rx_hdr->ch_id].receive_cb(bam_ch[rx_hdr->ch_id].priv,
 							rx_skb);
 	else
-		dev_kfree_skb_any(rx_skb);
+		skb_pool_recycle(&bam_rx_skb_pool, rx_skb, BUFFER_SIZE);
 	spin_unlock_irqrestore(&bam_ch[rx_hdr->ch_id].lock, flags);
 
 	queue_rx();
@@ -228,7 +232,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			" pad %d ch %d len %d\n", __func__,
 			rx_hdr->magic_num, rx_hdr->reserved, rx_hdr->cmd,
 			rx_hdr->pad_len, rx_hdr->ch_id, rx_hdr->pkt_len);
-		dev_kfree_skb_any(rx_skb);
+		skb_pool_recycle(&bam_rx_skb_pool, rx_skb, BUFFER_SIZE);
 		queue_rx();
 		return;
 	}
@@ -241,7 +245,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 		spin_lock_irqsave(&bam_ch[rx_hdr->ch_id].lock, flags);
 		bam_ch[rx_hdr->ch_id].status |= BAM_CH_REMOTE_OPEN;
 		spin_unlock_irqrestore(&bam_ch[rx_hdr->ch_id].lock, flags);
-		dev_kfree_skb_any(rx_skb);
+		skb_pool_recycle(&bam_rx_skb_pool, rx_skb, BUFFER_SIZE);
 		queue_rx();
 		break;
 	case BAM_MUX_HDR_CMD_CLOSE:
@@ -249,7 +253,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 		spin_lock_irqsave(&bam_ch[rx_hdr->ch_id].lock, flags);
 		bam_ch[rx_hdr->ch_id].status &= ~BAM_CH_REMOTE_OPEN;
 		spin_unlock_irqrestore(&bam_ch[rx_hdr->ch_id].lock, flags);
-		dev_kfree_skb_any(rx_skb);
+		skb_pool_recycle(&bam_rx_skb_pool, rx_skb, BUFFER_SIZE);
 		queue_rx();
 		break;
 	default:
@@ -257,7 +261,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			" pad %d ch %d len %d\n", __func__,
 			rx_hdr->magic_num, rx_hdr->reserved, rx_hdr->cmd,
 			rx_hdr->pad_len, rx_hdr->ch_id, rx_hdr->pkt_len);
-		dev_kfree_skb_any(rx_skb);
+		skb_pool_recycle(&bam_rx_skb_pool, rx_skb, BUFFER_SIZE);
 		queue_rx();
 		return;
 	}
@@ -557,6 +561,14 @@ static int debug_tbl(char *buf, int max)
 	return i;
 }
 
+static int debug_rx_pool(char *buf, int max)
+{
+	return scnprintf(buf, max,
+		"hits %lu  misses %lu  recycled %lu  rejected %lu\n",
+		bam_rx_skb_pool.hits, bam_rx_skb_pool.misses,
+		bam_rx_skb_pool.recycled, bam_rx_skb_pool.rejected);
+}
+
 #define DEBUG_BUFMAX 4096
 static char debug_buffer[DEBUG_BUFMAX];
 
@@ -771,10 +783,15 @@ static int __init bam_dmux_init(void)
 {
 #ifdef CONFIG_DEBUG_FS
 	struct dentry *dent;
+#endif
 
+	skb_pool_init(&bam_rx_skb_pool, RX_POOL_LEN);
+#ifdef CONFIG_DEBUG_FS
 	dent = debugfs_create_dir("bam_dmux", 0);
-	if (!IS_ERR(dent))
+	if (!IS_ERR(dent)) {
 		debug_create("tbl", 0444, dent, debug_tbl);
+		debug_create("rx_pool", 0444, dent, debug_rx_pool);
+	}
 #endif
 	return platform_driver_register(&bam_dmux_driver);
 }
@@ -16,9 +16,16 @@
 #include <linux/cpuidle.h>
 
 #include "cpuidle.h"
+#include "idle_predict.h"
 #include "pm.h"
 
 static DEFINE_PER_CPU_SHARED_ALIGNED(struct cpuidle_device, msm_cpuidle_devs);
+
+/*
+ * msm_pm_idle_prepare() zeroes the cpuidle residencies, keep the
+ * platform's break-even times for the idle predictor's statistics.
+ */
+static DEFINE_PER_CPU(uint32_t [CPUIDLE_STATE_MAX], msm_cpuidle_residency);
 static struct cpuidle_driver msm_cpuidle_driver = {
 	.name = "msm_idle",
 	.owner = THIS_MODULE,
@@ -63,6 +70,11 @@ static int msm_cpuidle_enter(
 
 	ret = msm_pm_idle_enter((enum msm_pm_sleep_mode) (state->driver_data));
 
+	msm_idle_predict_update(dev->cpu, ret,
+		__get_cpu_var(msm_cpuidle_residency)[state - dev->states],
+		(enum msm_pm_sleep_mode) (state->driver_data) !=
+			MSM_PM_SLEEP_MODE_WAIT_FOR_INTERRUPT);
+
 #ifdef CONFIG_MSM_SLEEP_STATS
 	atomic_notifier_call_chain(head, MSM_CPUIDLE_STATE_EXIT, NULL);
 #endif
@@ -102,6 +114,8 @@ void __init msm_cpuidle_set_states(struct msm_cpuidle_state *states,
 			state->exit_latency = pm_mode->latency;
 			state->power_usage = 0;
 			state->target_residency = pm_mode->residency;
+			per_cpu(msm_cpuidle_residency, cpu)[cstate->state_nr] =
+				pm_mode->residency;
 			state->enter = msm_cpuidle_enter;
 		}
 
@@ -0,0 +1,253 @@
+/* Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * Idle length prediction from recent interrupt wakeups
+ *
+ * msm_pm_idle_prepare() picks WFI, standalone or full power collapse
+ * and the RPM resource limits from the time to the next timer event.
+ * A cpu that is woken by a device interrupt every couple of
+ * milliseconds therefore keeps paying for power collapses it leaves
+ * long before they break even.
+ *
+ * Each idle period that ends well before its timer is recorded as an
+ * interrupt wakeup. When the last few such periods are consistent,
+ * their average is used instead of the timer as the expected sleep
+ * length. A timer wakeup past the prediction means the pattern has
+ * ended and the history is dropped.
+ *
+ * The algorithm is mirrored by tools/power/msm/idle_predict_sim.c,
+ * which replays msm_idle:msm_idle_exit traces; keep the two in sync.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include "idle_predict.h"
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/msm_idle.h>
+
+#define IDLE_PREDICT_SAMPLES	8
+#define IDLE_PREDICT_MAX_US	1000000
+#define IDLE_PREDICT_STDDEV_US	20
+
+static int idle_predict_enabled = 1;
+module_param_named(enabled, idle_predict_enabled,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* Interrupt wakeups needed before a prediction is made */
+static unsigned int min_samples = 3;
+module_param_named(min_samples, min_samples,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* History older than this is stale and dropped */
+static unsigned int history_ms = 1000;
+module_param_named(history_ms, history_ms,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+struct idle_predict_stats {
+	unsigned long nr_idle;
+	unsigned long nr_irq_wakeups;
+	unsigned long nr_predicted;	/* sleep length shortened */
+	unsigned long nr_mispredicted;	/* slept to the timer anyway */
+	unsigned long nr_collapsed;
+	unsigned long nr_collapsed_early; /* woke before break-even */
+};
+
+struct idle_predict {
+	uint32_t intervals[IDLE_PREDICT_SAMPLES];
+	unsigned int nr;
+	unsigned int next;
+	int64_t last_us;		/* time of the last recorded wakeup */
+	uint32_t sleep_us;		/* timer based, for this idle period */
+	uint32_t predicted_us;
+	struct idle_predict_stats stats;
+};
+
+static DEFINE_PER_CPU(struct idle_predict, idle_predict);
+
+/*
+ * Average of the recorded interrupt intervals if they are consistent,
+ * 0 otherwise. The largest interval is discarded as an outlier if that
+ * makes the rest consistent.
+ */
+static uint32_t idle_predict_typical(struct idle_predict *p)
+{
+	uint32_t limit = UINT_MAX;
+	uint32_t largest;
+	uint64_t sum, avg, var;
+	unsigned int i, n;
+	int attempt;
+
+	for (attempt = 0; attempt < 2; attempt++) {
+		sum = 0;
+		n = 0;
+		largest = 0;
+		for (i = 0; i < p->nr; i++) {
+			if (p->intervals[i] > limit)
+				continue;
+			sum += p->intervals[i];
+			largest = max(largest, p->intervals[i]);
+			n++;
+		}
+		if (!n || n < min_samples)
+			return 0;
+		avg = div_u64(sum, n);
+
+		var = 0;
+		for (i = 0; i < p->nr; i++) {
+			int64_t d = (int64_t)p->intervals[i] - (int64_t)avg;
+
+			if (p->intervals[i] > limit)
+				continue;
+			var += d * d;
+		}
+		var = div_u64(var, n);
+
+		/* stddev below avg/6, or below a few tens of us */
+		if (var <= IDLE_PREDICT_STDDEV_US * IDLE_PREDICT_STDDEV_US ||
+		    avg * avg > 36 * var)
+			return (uint32_t)avg;
+
+		limit = largest - 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Called from msm_pm_idle_prepare() with the time to the next timer
+ * event; returns the sleep length the idle state choice should use.
+ */
+uint32_t msm_idle_predict_sleep_us(unsigned int cpu, uint32_t sleep_us)
+{
+	struct idle_predict *p = &per_cpu(idle_predict, cpu);
+	uint32_t typical;
+
+	p->sleep_us = sleep_us;
+	p->predicted_us = sleep_us;
+
+	if (!idle_predict_enabled || !p->nr)
+		return sleep_us;
+
+	if (ktime_to_us(ktime_get()) - p->last_us >
+	    (int64_t)history_ms * USEC_PER_MSEC) {
+		p->nr = 0;
+		p->next = 0;
+		return sleep_us;
+	}
+
+	typical = idle_predict_typical(p);
+	if (typical && typical < sleep_us) {
+		p->predicted_us = typical;
+		p->stats.nr_predicted++;
+	}
+
+	return p->predicted_us;
+}
+
+/*
+ * Called on the way out of idle with the measured idle length and, for
+ * power collapse, the mode's break-even residency.
+ */
+void msm_idle_predict_update(unsigned int cpu, uint32_t idle_us,
+		uint32_t residency_us, bool collapsed)
+{
+	struct idle_predict *p = &per_cpu(idle_predict, cpu);
+	uint32_t slack = max(p->sleep_us >> 3, 100U);
+
+	trace_msm_idle_exit(cpu, p->sleep_us, p->predicted_us, idle_us,
+			    collapsed);
+
+	p->stats.nr_idle++;
+	if (collapsed) {
+		p->stats.nr_collapsed++;
+		if (idle_us < residency_us)
+			p->stats.nr_collapsed_early++;
+	}
+
+	if (idle_us + slack >= p->sleep_us) {
+		/* timer wakeup: a pattern that predicted less has ended */
+		if (p->predicted_us < p->sleep_us &&
+		    idle_us > 2 * p->predicted_us) {
+			p->stats.nr_mispredicted++;
+			p->nr = 0;
+			p->next = 0;
+		}
+		return;
+	}
+
+	p->stats.nr_irq_wakeups++;
+	p->intervals[p->next] = min(idle_us, (uint32_t)IDLE_PREDICT_MAX_US);
+	p->next = (p->next + 1) % IDLE_PREDICT_SAMPLES;
+	if (p->nr < IDLE_PREDICT_SAMPLES)
+		p->nr++;
+	p->last_us = ktime_to_us(ktime_get());
+}
+
+static int msm_idle_predict_stats_show(struct seq_file *m, void *unused)
+{
+	unsigned int cpu;
+
+	seq_printf(m, "enabled: %d\n", idle_predict_enabled);
+	for_each_possible_cpu(cpu) {
+		struct idle_predict_stats *s = &per_cpu(idle_predict, cpu).stats;
+
+		seq_printf(m, "cpu%u: idle %lu irq_wakeups %lu predicted %lu "
+			   "mispredicted %lu collapsed %lu collapsed_early %lu\n",
+			   cpu, s->nr_idle, s->nr_irq_wakeups, s->nr_predicted,
+			   s->nr_mispredicted, s->nr_collapsed,
+			   s->nr_collapsed_early);
+	}
+
+	return 0;
+}
+
+static int msm_idle_predict_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_idle_predict_stats_show, NULL);
+}
+
+static ssize_t msm_idle_predict_stats_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(&per_cpu(idle_predict, cpu).stats, 0,
+		       sizeof(struct idle_predict_stats));
+
+	return count;
+}
+
+static const struct file_operations msm_idle_predict_stats_fops = {
+	.open		= msm_idle_predict_stats_open,
+	.read		= seq_read,
+	.write		= msm_idle_predict_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init msm_idle_predict_init(void)
+{
+	debugfs_create_file("msm_idle_predict", S_IRUGO | S_IWUSR, NULL, NULL,
+			    &msm_idle_predict_stats_fops);
+	return 0;
+}
+late_initcall(msm_idle_predict_init);
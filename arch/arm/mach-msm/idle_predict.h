@@ -0,0 +1,31 @@
+/* Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef __ARCH_ARM_MACH_MSM_IDLE_PREDICT_H
+#define __ARCH_ARM_MACH_MSM_IDLE_PREDICT_H
+
+#include <linux/types.h>
+
+#ifdef CONFIG_MSM_IDLE_PREDICT
+uint32_t msm_idle_predict_sleep_us(unsigned int cpu, uint32_t sleep_us);
+void msm_idle_predict_update(unsigned int cpu, uint32_t idle_us,
+		uint32_t residency_us, bool collapsed);
+#else
+static inline uint32_t msm_idle_predict_sleep_us(unsigned int cpu,
+		uint32_t sleep_us)
+{ return sleep_us; }
+static inline void msm_idle_predict_update(unsigned int cpu,
+		uint32_t idle_us, uint32_t residency_us, bool collapsed) {}
+#endif
+
+#endif /* __ARCH_ARM_MACH_MSM_IDLE_PREDICT_H */
@@ -0,0 +1,338 @@
+/* Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * Qualcomm MSM runqueue based CPU hotplug governor
+ *
+ * Brings secondary cores online when the scheduler's time weighted
+ * average of runnable tasks per online core stays above up_threshold,
+ * and takes the least loaded secondary core offline when the average
+ * stays below down_threshold and that core is mostly idle. Separate up
+ * and down delays plus a minimum online time provide the hysteresis
+ * that keeps cores from bouncing.
+ *
+ * With CONFIG_HOTPLUG_CPU_PARK cores are parked instead of going
+ * through cpu_down(), avoiding stop_machine() on every transition.
+ *
+ * Hotplug latency and per online-count residency, a proxy for the
+ * energy spent, are reported in debugfs/msm_hotplug.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/cpu.h>
+#include <linux/sched.h>
+#include <linux/tick.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+static int msm_hotplug_enabled;
+module_param_named(enabled, msm_hotplug_enabled,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static unsigned int sample_ms = 50;
+module_param_named(sample_ms, sample_ms,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* Runnable tasks per online core, scaled by 100 */
+static unsigned int up_threshold = 125;
+module_param_named(up_threshold, up_threshold,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static unsigned int down_threshold = 60;
+module_param_named(down_threshold, down_threshold,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* Busy percentage below which a secondary core may go offline */
+static unsigned int down_load = 25;
+module_param_named(down_load, down_load,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* Consecutive samples a condition must hold before acting */
+static unsigned int up_delay = 1;
+module_param_named(up_delay, up_delay,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static unsigned int down_delay = 10;
+module_param_named(down_delay, down_delay,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static unsigned int min_online_ms = 1000;
+module_param_named(min_online_ms, min_online_ms,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+#ifdef CONFIG_HOTPLUG_CPU_PARK
+/* Park and unpark secondary cores rather than cpu_down()/cpu_up() */
+static int park_mode = 1;
+module_param_named(park, park_mode,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+#else
+#define park_mode 0
+#endif
+
+struct hotplug_cpu_load {
+	u64 prev_idle;
+	u64 prev_wall;
+	unsigned int load;
+};
+
+struct hotplug_stats {
+	unsigned long nr_up;
+	unsigned long nr_down;
+	u64 up_time_us;		/* summed cpu_up() latency */
+	u64 down_time_us;
+	unsigned int max_up_us;
+	unsigned int max_down_us;
+	u64 residency_ms[NR_CPUS + 1];	/* indexed by online count */
+};
+
+static struct {
+	struct delayed_work work;
+	struct mutex lock;
+	struct sched_nr_avg nr_avg;
+	unsigned int up_count;
+	unsigned int down_count;
+	unsigned long last_change;	/* jiffies */
+	ktime_t last_sample;
+	unsigned int last_avg;
+	struct hotplug_stats stats;
+} hp;
+
+static DEFINE_PER_CPU(struct hotplug_cpu_load, hp_cpu_load);
+static struct workqueue_struct *hotplug_wq;
+
+static void update_cpu_load(int cpu)
+{
+	struct hotplug_cpu_load *l = &per_cpu(hp_cpu_load, cpu);
+	u64 idle, wall;
+	unsigned int d_idle, d_wall;
+
+	idle = get_cpu_idle_time_us(cpu, &wall);
+	if (idle == -1ULL) {
+		l->load = 0;
+		return;
+	}
+
+	d_idle = (unsigned int)(idle - l->prev_idle);
+	d_wall = (unsigned int)(wall - l->prev_wall);
+	l->prev_idle = idle;
+	l->prev_wall = wall;
+
+	if (!d_wall || d_idle > d_wall)
+		l->load = 0;
+	else
+		l->load = 100 * (d_wall - d_idle) / d_wall;
+}
+
+/* Cores available to the scheduler, i.e. online and not parked */
+static const struct cpumask *hotplug_cpu_mask(void)
+{
+	return park_mode ? cpu_active_mask : cpu_online_mask;
+}
+
+static int least_loaded_secondary(void)
+{
+	unsigned int min_load = UINT_MAX;
+	int cpu, target = -1;
+
+	for_each_cpu(cpu, hotplug_cpu_mask()) {
+		if (!cpu)
+			continue;
+		if (per_cpu(hp_cpu_load, cpu).load < min_load) {
+			min_load = per_cpu(hp_cpu_load, cpu).load;
+			target = cpu;
+		}
+	}
+
+	return target;
+}
+
+static void hotplug_account_residency(unsigned int online)
+{
+	ktime_t now = ktime_get();
+
+	if (hp.last_sample.tv64)
+		hp.stats.residency_ms[online] +=
+			ktime_to_ms(ktime_sub(now, hp.last_sample));
+	hp.last_sample = now;
+}
+
+static int hotplug_cpu_set(int cpu, bool up)
+{
+#ifdef CONFIG_HOTPLUG_CPU_PARK
+	if (cpu_parked(cpu) || (park_mode && cpu_online(cpu)))
+		return up ? cpu_unpark(cpu) : cpu_park(cpu);
+#endif
+	return up ? cpu_up(cpu) : cpu_down(cpu);
+}
+
+static void hotplug_cpu_up(void)
+{
+	ktime_t start;
+	unsigned int us;
+	int cpu;
+
+	cpu = cpumask_next_zero(0, hotplug_cpu_mask());
+	if (cpu >= nr_cpu_ids || !cpu_present(cpu))
+		return;
+
+	start = ktime_get();
+	if (hotplug_cpu_set(cpu, true))
+		return;
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+
+	hp.stats.nr_up++;
+	hp.stats.up_time_us += us;
+	hp.stats.max_up_us = max(hp.stats.max_up_us, us);
+	hp.last_change = jiffies;
+
+	/* Start the new core's load sample from now */
+	update_cpu_load(cpu);
+}
+
+static void hotplug_cpu_down(void)
+{
+	ktime_t start;
+	unsigned int us;
+	int cpu;
+
+	cpu = least_loaded_secondary();
+	if (cpu < 0 || per_cpu(hp_cpu_load, cpu).load >= down_load)
+		return;
+
+	start = ktime_get();
+	if (hotplug_cpu_set(cpu, false))
+		return;
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+
+	hp.stats.nr_down++;
+	hp.stats.down_time_us += us;
+	hp.stats.max_down_us = max(hp.stats.max_down_us, us);
+	hp.last_change = jiffies;
+}
+
+static void hotplug_work_fn(struct work_struct *work)
+{
+	unsigned int online, avg;
+	int cpu;
+
+	mutex_lock(&hp.lock);
+
+	online = cpumask_weight(hotplug_cpu_mask());
+	hotplug_account_residency(online);
+
+	avg = sched_get_nr_running_avg(&hp.nr_avg);
+	hp.last_avg = avg;
+
+	for_each_online_cpu(cpu)
+		update_cpu_load(cpu);
+
+	if (!msm_hotplug_enabled)
+		goto out;
+
+	avg /= online;
+
+	if (avg > up_threshold && online < num_present_cpus()) {
+		hp.down_count = 0;
+		if (++hp.up_count >= up_delay) {
+			hp.up_count = 0;
+			hotplug_cpu_up();
+		}
+	} else if (avg < down_threshold && online > 1) {
+		hp.up_count = 0;
+		if (++hp.down_count >= down_delay &&
+		    time_after(jiffies, hp.last_change +
+			       msecs_to_jiffies(min_online_ms))) {
+			hp.down_count = 0;
+			hotplug_cpu_down();
+		}
+	} else {
+		hp.up_count = 0;
+		hp.down_count = 0;
+	}
+
+out:
+	mutex_unlock(&hp.lock);
+	queue_delayed_work(hotplug_wq, &hp.work,
+			   msecs_to_jiffies(max(sample_ms, 10U)));
+}
+
+static int msm_hotplug_stats_show(struct seq_file *m, void *unused)
+{
+	struct hotplug_stats *s = &hp.stats;
+	unsigned int i;
+
+	mutex_lock(&hp.lock);
+	seq_printf(m, "enabled: %d park: %d\n", msm_hotplug_enabled,
+		   park_mode);
+	seq_printf(m, "nr_running_avg: %u.%02u\n",
+		   hp.last_avg / 100, hp.last_avg % 100);
+	seq_printf(m, "up: %lu avg_us: %llu max_us: %u\n", s->nr_up,
+		   s->nr_up ? div64_u64(s->up_time_us, s->nr_up) : 0,
+		   s->max_up_us);
+	seq_printf(m, "down: %lu avg_us: %llu max_us: %u\n", s->nr_down,
+		   s->nr_down ? div64_u64(s->down_time_us, s->nr_down) : 0,
+		   s->max_down_us);
+	for (i = 1; i <= num_possible_cpus(); i++)
+		seq_printf(m, "online %u: %llu ms\n", i, s->residency_ms[i]);
+	mutex_unlock(&hp.lock);
+
+	return 0;
+}
+
+static int msm_hotplug_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_hotplug_stats_show, NULL);
+}
+
+static ssize_t msm_hotplug_stats_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	mutex_lock(&hp.lock);
+	memset(&hp.stats, 0, sizeof(hp.stats));
+	hp.last_sample = ktime_get();
+	mutex_unlock(&hp.lock);
+
+	return count;
+}
+
+static const struct file_operations msm_hotplug_stats_fops = {
+	.open		= msm_hotplug_stats_open,
+	.read		= seq_read,
+	.write		= msm_hotplug_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init msm_hotplug_init(void)
+{
+	hotplug_wq = create_singlethread_workqueue("msm_hotplug");
+	if (!hotplug_wq)
+		return -ENOMEM;
+
+	mutex_init(&hp.lock);
+	INIT_DELAYED_WORK_DEFERRABLE(&hp.work, hotplug_work_fn);
+	/* jiffies starts out negative, so 0 would hold cores for minutes */
+	hp.last_change = jiffies;
+
+	debugfs_create_file("msm_hotplug", S_IRUGO | S_IWUSR, NULL, NULL,
+			    &msm_hotplug_stats_fops);
+
+	queue_delayed_work(hotplug_wq, &hp.work, msecs_to_jiffies(sample_ms));
+	return 0;
+}
+late_initcall(msm_hotplug_init);
@@ -39,6 +39,7 @@ struct rq_data {
 	struct attribute_group *attr_group;
 	struct kobject *kobj;
 	struct delayed_work def_timer_work;
+	struct sched_nr_avg nr_avg;
 };
 
 static struct rq_data rq_info;
@@ -58,7 +59,8 @@ static void rq_work_fn(struct work_struct *work)
 	if (!rq_info.rq_avg)
 		rq_info.total_time = 0;
 
-	rq_avg = nr_running() * 10;
+	/* Scheduler's average since the last poll, scaled by 100 */
+	rq_avg = sched_get_nr_running_avg(&rq_info.nr_avg) / 10;
 	time_diff = ktime_to_ns(ktime_get()) - rq_info.last_time;
 	do_div(time_diff, (1000 * 1000));
 
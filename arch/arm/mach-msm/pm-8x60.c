@@ -42,6 +42,7 @@
 #include "avs.h"
 #include "cpuidle.h"
 #include "idle.h"
+#include "idle_predict.h"
 #include "pm.h"
 #include "rpm_resources.h"
 #include "scm-boot.h"
@@ -754,6 +755,7 @@ int msm_pm_idle_prepare(struct cpuidle_device *dev)
 	latency_us = (uint32_t) pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
 	sleep_us = (uint32_t) ktime_to_ns(tick_nohz_get_sleep_length());
 	sleep_us = DIV_ROUND_UP(sleep_us, 1000);
+	sleep_us = msm_idle_predict_sleep_us(dev->cpu, sleep_us);
 
 	for (i = 0; i < dev->state_count; i++) {
 		struct cpuidle_state *state = &dev->states[i];
@@ -558,6 +558,11 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 	mutex_init(&q->sysfs_lock);
 	spin_lock_init(&q->__queue_lock);
 
+#ifdef CONFIG_BLK_WRITE_THROTTLING
+	q->wrt.win_msecs = 100;
+	q->wrt.depth = BLKDEV_MAX_RQ;
+#endif
+
 	return q;
 }
 EXPORT_SYMBOL(blk_alloc_queue_node);
@@ -770,6 +775,98 @@ static void freed_request(struct request_queue *q, int sync, int priv)
 		__freed_request(q, sync ^ 1);
 }
 
+#ifdef CONFIG_BLK_WRITE_THROTTLING
+/*
+ * Close the current sampling window if it has expired and adjust the
+ * number of buffered write requests the queue will hand out. Reads that
+ * missed the target halve the depth, reads within target grow it by a
+ * quarter, and a window without reads doubles it. queue_lock must be
+ * held.
+ */
+static void blk_wr_throttle_update(struct request_queue *q)
+{
+	struct blk_wr_throttle *wrt = &q->wrt;
+	unsigned int depth = wrt->depth;
+
+	if (!wrt->lat_target_us)
+		return;
+
+	if (time_before(jiffies, wrt->win_start +
+			msecs_to_jiffies(wrt->win_msecs)))
+		return;
+
+	if (!wrt->win_samples)
+		depth *= 2;
+	else if (wrt->win_min_ns > (u64)wrt->lat_target_us * NSEC_PER_USEC)
+		depth /= 2;
+	else
+		depth += max(depth / 4, 1U);
+
+	depth = clamp_t(unsigned int, depth, 1, q->nr_requests);
+	if (depth > wrt->depth &&
+	    waitqueue_active(&q->rq.wait[BLK_RW_ASYNC]))
+		wake_up_all(&q->rq.wait[BLK_RW_ASYNC]);
+
+	wrt->depth = depth;
+	wrt->win_start = jiffies;
+	wrt->win_min_ns = 0;
+	wrt->win_samples = 0;
+}
+
+static void blk_wr_throttle_done(struct request *req)
+{
+	struct request_queue *q = req->q;
+	struct blk_wr_throttle *wrt = &q->wrt;
+	u64 lat;
+
+	if (!req->wrt_start_ns)
+		return;
+
+	lat = ktime_to_ns(ktime_get()) - req->wrt_start_ns;
+	if (!wrt->win_samples || lat < wrt->win_min_ns)
+		wrt->win_min_ns = lat;
+	wrt->win_samples++;
+
+	blk_wr_throttle_update(q);
+}
+
+/*
+ * Should an allocation of a buffered write request be held back?
+ * Memory reclaim is never throttled. queue_lock must be held.
+ */
+static bool blk_wr_throttle_async(struct request_queue *q)
+{
+	if (!q->wrt.lat_target_us || (current->flags & PF_MEMALLOC))
+		return false;
+
+	blk_wr_throttle_update(q);
+	if (q->rq.count[BLK_RW_ASYNC] < q->wrt.depth)
+		return false;
+
+	q->wrt.nr_throttled++;
+	return true;
+}
+
+void blk_wr_throttle_set_target(struct request_queue *q, unsigned int us)
+{
+	spin_lock_irq(q->queue_lock);
+	q->wrt.lat_target_us = us;
+	q->wrt.depth = q->nr_requests;
+	q->wrt.win_start = jiffies;
+	q->wrt.win_min_ns = 0;
+	q->wrt.win_samples = 0;
+	spin_unlock_irq(q->queue_lock);
+
+	wake_up_all(&q->rq.wait[BLK_RW_ASYNC]);
+}
+#else
+static inline void blk_wr_throttle_done(struct request *req) {}
+static inline bool blk_wr_throttle_async(struct request_queue *q)
+{
+	return false;
+}
+#endif
+
 /*
  * Get a free request, queue_lock must be held.
  * Returns NULL on failure, with queue_lock held.
@@ -788,6 +885,10 @@ static struct request *get_request(struct request_queue *q, int rw_flags,
 	if (may_queue == ELV_MQUEUE_NO)
 		goto rq_starved;
 
+	if (!is_sync && may_queue != ELV_MQUEUE_MUST &&
+	    blk_wr_throttle_async(q))
+		goto out;
+
 	if (rl->count[is_sync]+1 >= queue_congestion_on_threshold(q)) {
 		if (rl->count[is_sync]+1 >= q->nr_requests) {
 			ioc = current_io_context(GFP_ATOMIC, q->node);
@@ -1196,6 +1297,12 @@ void init_request_from_bio(struct request *req, struct bio *bio)
 	req->__sector = bio->bi_sector;
 	req->ioprio = bio_prio(bio);
 	blk_rq_bio_prep(req->q, req, bio);
+
+#ifdef CONFIG_BLK_WRITE_THROTTLING
+	if (req->q->wrt.lat_target_us && !(bio->bi_rw & REQ_RAHEAD) &&
+	    rq_data_dir(req) == READ && rw_is_sync(req->cmd_flags))
+		req->wrt_start_ns = ktime_to_ns(ktime_get());
+#endif
 }
 
 /*
@@ -2223,6 +2330,7 @@ static void blk_finish_request(struct request *req, int error)
 
 
 	blk_account_io_done(req);
+	blk_wr_throttle_done(req);
 
 	if (req->end_io)
 		req->end_io(req, error);
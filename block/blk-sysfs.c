@@ -265,6 +265,55 @@ queue_rq_affinity_store(struct request_queue *q, const char *page, size_t count)
 	return ret;
 }
 
+#ifdef CONFIG_BLK_WRITE_THROTTLING
+static ssize_t queue_read_lat_target_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(q->wrt.lat_target_us, page);
+}
+
+static ssize_t
+queue_read_lat_target_store(struct request_queue *q, const char *page,
+			    size_t count)
+{
+	unsigned long us;
+	ssize_t ret = queue_var_store(&us, page, count);
+
+	if (us > UINT_MAX)
+		return -EINVAL;
+
+	blk_wr_throttle_set_target(q, us);
+	return ret;
+}
+
+static ssize_t queue_read_lat_window_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(q->wrt.win_msecs, page);
+}
+
+static ssize_t
+queue_read_lat_window_store(struct request_queue *q, const char *page,
+			    size_t count)
+{
+	unsigned long ms;
+	ssize_t ret = queue_var_store(&ms, page, count);
+
+	if (!ms || ms > 10000)
+		return -EINVAL;
+
+	spin_lock_irq(q->queue_lock);
+	q->wrt.win_msecs = ms;
+	spin_unlock_irq(q->queue_lock);
+	return ret;
+}
+
+static ssize_t queue_wr_throttle_show(struct request_queue *q, char *page)
+{
+	return sprintf(page, "%u %lu\n", q->wrt.lat_target_us ?
+		       q->wrt.depth : (unsigned int)q->nr_requests,
+		       q->wrt.nr_throttled);
+}
+#endif
+
 static struct queue_sysfs_entry queue_requests_entry = {
 	.attr = {.name = "nr_requests", .mode = S_IRUGO | S_IWUSR },
 	.show = queue_requests_show,
@@ -379,6 +428,25 @@ static struct queue_sysfs_entry queue_random_entry = {
 	.store = queue_store_random,
 };
 
+#ifdef CONFIG_BLK_WRITE_THROTTLING
+static struct queue_sysfs_entry queue_read_lat_target_entry = {
+	.attr = {.name = "read_lat_target_us", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_read_lat_target_show,
+	.store = queue_read_lat_target_store,
+};
+
+static struct queue_sysfs_entry queue_read_lat_window_entry = {
+	.attr = {.name = "read_lat_window_ms", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_read_lat_window_show,
+	.store = queue_read_lat_window_store,
+};
+
+static struct queue_sysfs_entry queue_wr_throttle_entry = {
+	.attr = {.name = "wr_throttle", .mode = S_IRUGO },
+	.show = queue_wr_throttle_show,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -401,6 +469,11 @@ static struct attribute *default_attrs[] = {
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
 	&queue_random_entry.attr,
+#ifdef CONFIG_BLK_WRITE_THROTTLING
+	&queue_read_lat_target_entry.attr,
+	&queue_read_lat_window_entry.attr,
+	&queue_wr_throttle_entry.attr,
+#endif
 	NULL,
 };
 
@@ -25,6 +25,10 @@ void blk_delete_timer(struct request *);
 void blk_add_timer(struct request *);
 void __generic_unplug_device(struct request_queue *);
 
+#ifdef CONFIG_BLK_WRITE_THROTTLING
+void blk_wr_throttle_set_target(struct request_queue *q, unsigned int us);
+#endif
+
 /*
  * Internal atomic flags for request handling
  */
@@ -0,0 +1,458 @@
+/*
+ *  Flash i/o scheduler.
+ *
+ *  Based on the deadline i/o scheduler, Copyright (C) 2002 Jens Axboe.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+#include <linux/log2.h>
+
+/*
+ * See Documentation/block/flash-iosched.txt
+ */
+static const int write_expire = HZ;	/* max time before a buffered write is submitted */
+static const int writes_starved = 4;	/* max times sync requests can starve writes */
+static const int write_batch = 16;	/* max requests in one write batch */
+static const int erase_block_kb = 512;	/* write batches stay within this */
+
+enum {
+	FLASH_ASYNC = 0,
+	FLASH_SYNC,
+};
+
+struct flash_data {
+	/*
+	 * run time data
+	 */
+
+	/*
+	 * requests are present on both sort_list (by data direction, for
+	 * merging and write batching) and fifo_list (sync or async)
+	 */
+	struct rb_root sort_list[2];
+	struct list_head fifo_list[2];
+
+	unsigned int starved;		/* times sync requests have starved writes */
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int write_expire;
+	int writes_starved;
+	int write_batch;
+	int erase_block;		/* in sectors, power of two */
+	int front_merges;
+};
+
+static void flash_move_to_dispatch(struct flash_data *, struct request *);
+
+static inline struct rb_root *
+flash_rb_root(struct flash_data *fd, struct request *rq)
+{
+	return &fd->sort_list[rq_data_dir(rq)];
+}
+
+static inline int flash_rq_class(struct request *rq)
+{
+	return rq_is_sync(rq) ? FLASH_SYNC : FLASH_ASYNC;
+}
+
+/*
+ * get the request after `rq' in sector-sorted order
+ */
+static inline struct request *
+flash_latter_request(struct request *rq)
+{
+	struct rb_node *node = rb_next(&rq->rb_node);
+
+	if (node)
+		return rb_entry_rq(node);
+
+	return NULL;
+}
+
+/*
+ * get the first request at or after `sector' in sector-sorted order
+ */
+static struct request *
+flash_ceil_request(struct rb_root *root, sector_t sector)
+{
+	struct rb_node *n = root->rb_node;
+	struct request *rq, *ceil = NULL;
+
+	while (n) {
+		rq = rb_entry_rq(n);
+
+		if (sector < blk_rq_pos(rq)) {
+			ceil = rq;
+			n = n->rb_left;
+		} else if (sector > blk_rq_pos(rq))
+			n = n->rb_right;
+		else
+			return rq;
+	}
+
+	return ceil;
+}
+
+static void
+flash_add_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	struct rb_root *root = flash_rb_root(fd, rq);
+	struct request *__alias;
+
+	while (unlikely(__alias = elv_rb_add(root, rq)))
+		flash_move_to_dispatch(fd, __alias);
+}
+
+/*
+ * add rq to rbtree and fifo
+ */
+static void
+flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int class = flash_rq_class(rq);
+
+	flash_add_rq_rb(fd, rq);
+
+	/*
+	 * sync requests are served in arrival order, buffered writes get
+	 * a deadline to bound their starvation
+	 */
+	if (class == FLASH_ASYNC)
+		rq_set_fifo_time(rq, jiffies + fd->write_expire);
+	else
+		rq_set_fifo_time(rq, jiffies);
+	list_add_tail(&rq->queuelist, &fd->fifo_list[class]);
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void flash_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	rq_fifo_clear(rq);
+	elv_rb_del(flash_rb_root(fd, rq), rq);
+}
+
+static int
+flash_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *__rq;
+	int ret;
+
+	/*
+	 * check for front merge
+	 */
+	if (fd->front_merges) {
+		sector_t sector = bio->bi_sector + bio_sectors(bio);
+
+		__rq = elv_rb_find(&fd->sort_list[bio_data_dir(bio)], sector);
+		if (__rq) {
+			BUG_ON(sector != blk_rq_pos(__rq));
+
+			if (elv_rq_merge_ok(__rq, bio)) {
+				ret = ELEVATOR_FRONT_MERGE;
+				goto out;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+out:
+	*req = __rq;
+	return ret;
+}
+
+static void flash_merged_request(struct request_queue *q,
+				 struct request *req, int type)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(flash_rb_root(fd, req), req);
+		flash_add_rq_rb(fd, req);
+	}
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next is queued ahead of rq in the same fifo, move rq into
+	 * its position (next will be deleted) and take its expire time
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist) &&
+	    flash_rq_class(req) == flash_rq_class(next)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	flash_remove_request(q, next);
+}
+
+/*
+ * move request from sort list to dispatch queue.
+ */
+static void
+flash_move_to_dispatch(struct flash_data *fd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	flash_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+/*
+ * flash_async_expired returns 1 if the oldest buffered write has waited
+ * past its deadline. Requires !list_empty(&fd->fifo_list[FLASH_ASYNC])
+ */
+static inline int flash_async_expired(struct flash_data *fd)
+{
+	struct request *rq = rq_entry_fifo(fd->fifo_list[FLASH_ASYNC].next);
+
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+/*
+ * Dispatch the writes that fall in the erase block of the oldest
+ * buffered write, in sector order, so that the device sees them back to
+ * back and can program (or pack) them together.
+ */
+static int flash_dispatch_write_batch(struct flash_data *fd)
+{
+	struct request *rq = rq_entry_fifo(fd->fifo_list[FLASH_ASYNC].next);
+	sector_t start, end;
+	struct request *next;
+	int batched = 0;
+
+	fd->starved = 0;
+
+	start = blk_rq_pos(rq) & ~((sector_t)fd->erase_block - 1);
+	end = start + fd->erase_block;
+
+	rq = flash_ceil_request(&fd->sort_list[WRITE], start);
+	while (rq && blk_rq_pos(rq) < end && batched < fd->write_batch) {
+		next = flash_latter_request(rq);
+		flash_move_to_dispatch(fd, rq);
+		batched++;
+		rq = next;
+	}
+
+	return batched;
+}
+
+/*
+ * flash_dispatch_requests never idles: sync requests go first, in
+ * arrival order, unless buffered writes have been starved for too long
+ * or have run past their deadline.
+ */
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int sync = !list_empty(&fd->fifo_list[FLASH_SYNC]);
+	const int async = !list_empty(&fd->fifo_list[FLASH_ASYNC]);
+
+	if (async && (!sync || fd->starved >= fd->writes_starved ||
+		      flash_async_expired(fd)))
+		return flash_dispatch_write_batch(fd);
+
+	if (sync) {
+		if (async)
+			fd->starved++;
+		flash_move_to_dispatch(fd,
+			rq_entry_fifo(fd->fifo_list[FLASH_SYNC].next));
+		return 1;
+	}
+
+	return 0;
+}
+
+static int flash_queue_empty(struct request_queue *q)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	return list_empty(&fd->fifo_list[FLASH_ASYNC])
+		&& list_empty(&fd->fifo_list[FLASH_SYNC]);
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	BUG_ON(!list_empty(&fd->fifo_list[FLASH_SYNC]));
+	BUG_ON(!list_empty(&fd->fifo_list[FLASH_ASYNC]));
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	INIT_LIST_HEAD(&fd->fifo_list[FLASH_SYNC]);
+	INIT_LIST_HEAD(&fd->fifo_list[FLASH_ASYNC]);
+	fd->sort_list[READ] = RB_ROOT;
+	fd->sort_list[WRITE] = RB_ROOT;
+	fd->write_expire = write_expire;
+	fd->writes_starved = writes_starved;
+	fd->write_batch = write_batch;
+	fd->erase_block = erase_block_kb * 2;
+	fd->front_merges = 1;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_write_expire_show, fd->write_expire, 1);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_write_batch_show, fd->write_batch, 0);
+SHOW_FUNCTION(flash_erase_block_kb_show, fd->erase_block / 2, 0);
+SHOW_FUNCTION(flash_front_merges_show, fd->front_merges, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_write_expire_store, &fd->write_expire, 0, INT_MAX, 1);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_write_batch_store, &fd->write_batch, 1, INT_MAX, 0);
+STORE_FUNCTION(flash_front_merges_store, &fd->front_merges, 0, 1, 0);
+#undef STORE_FUNCTION
+
+/*
+ * The erase block size is rounded down to a power of two; the card's
+ * preferred_erase_size attribute is a good value to write here.
+ */
+static ssize_t
+flash_erase_block_kb_store(struct elevator_queue *e, const char *page,
+			   size_t count)
+{
+	struct flash_data *fd = e->elevator_data;
+	int __data;
+	int ret = flash_var_store(&__data, page, count);
+
+	if (__data < 1)
+		__data = 1;
+	else if (__data > INT_MAX / 2)
+		__data = INT_MAX / 2;
+	fd->erase_block = rounddown_pow_of_two(__data) * 2;
+	return ret;
+}
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(write_expire),
+	FD_ATTR(writes_starved),
+	FD_ATTR(write_batch),
+	FD_ATTR(erase_block_kb),
+	FD_ATTR(front_merges),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_fn = 		flash_merge,
+		.elevator_merged_fn =		flash_merged_request,
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_queue_empty_fn =	flash_queue_empty,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash IO scheduler");
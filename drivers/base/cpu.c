@@ -62,9 +62,45 @@ static ssize_t __ref store_online(struct sys_device *dev, struct sysdev_attribut
 }
 static SYSDEV_ATTR(online, 0644, show_online, store_online);
 
+#ifdef CONFIG_HOTPLUG_CPU_PARK
+static ssize_t show_parked(struct sys_device *dev, struct sysdev_attribute *attr,
+			   char *buf)
+{
+	struct cpu *cpu = container_of(dev, struct cpu, sysdev);
+
+	return sprintf(buf, "%u\n", !!cpu_parked(cpu->sysdev.id));
+}
+
+static ssize_t store_parked(struct sys_device *dev, struct sysdev_attribute *attr,
+			    const char *buf, size_t count)
+{
+	struct cpu *cpu = container_of(dev, struct cpu, sysdev);
+	ssize_t ret;
+
+	switch (buf[0]) {
+	case '0':
+		ret = cpu_unpark(cpu->sysdev.id);
+		break;
+	case '1':
+		ret = cpu_park(cpu->sysdev.id);
+		break;
+	default:
+		ret = -EINVAL;
+	}
+
+	if (ret >= 0)
+		ret = count;
+	return ret;
+}
+static SYSDEV_ATTR(parked, 0644, show_parked, store_parked);
+#endif
+
 static void __cpuinit register_cpu_control(struct cpu *cpu)
 {
 	sysdev_create_file(&cpu->sysdev, &attr_online);
+#ifdef CONFIG_HOTPLUG_CPU_PARK
+	sysdev_create_file(&cpu->sysdev, &attr_parked);
+#endif
 }
 void unregister_cpu(struct cpu *cpu)
 {
@@ -73,6 +109,9 @@ void unregister_cpu(struct cpu *cpu)
 	unregister_cpu_under_node(logical_cpu, cpu_to_node(logical_cpu));
 
 	sysdev_remove_file(&cpu->sysdev, &attr_online);
+#ifdef CONFIG_HOTPLUG_CPU_PARK
+	sysdev_remove_file(&cpu->sysdev, &attr_parked);
+#endif
 
 	sysdev_unregister(&cpu->sysdev);
 	per_cpu(cpu_sys_devices, logical_cpu) = NULL;
@@ -79,6 +79,15 @@ struct dpm_drv_wd_data {
 
 static int async_error;
 
+/*
+ * For the critical path report: start of the current transition and the
+ * device handled synchronously last, which the next synchronous device
+ * implicitly waits for.
+ */
+static ktime_t dpm_transition_start;
+static struct device *dpm_last_sync;
+static ktime_t dpm_last_sync_end;
+
 /**
  * device_pm_init - Initialize the PM-related part of a device object.
  * @dev: Device object being initialized.
@@ -220,15 +229,87 @@ static void dpm_wait(struct device *dev, bool async)
 		wait_for_completion(&dev->power.completion);
 }
 
-static int dpm_wait_fn(struct device *dev, void *async_ptr)
+static void dpm_start_transition(void)
 {
-	dpm_wait(dev, *((bool *)async_ptr));
+	dpm_transition_start = ktime_get();
+	dpm_last_sync = NULL;
+}
+
+static void dpm_reset_timing(struct device *dev)
+{
+	dev->power.pm_blocker = NULL;
+	dev->power.pm_blocker_end = ktime_set(0, 0);
+}
+
+/**
+ * dpm_note_dep - Record a dependency of a device for the current transition.
+ * @dev: Device being handled.
+ * @dep: Device @dev had to wait for.
+ * @end: Time at which @dep was done.
+ *
+ * Only the dependency that was done last is kept, it is the one that held
+ * @dev back. @dep is not dereferenced later, it may go away.
+ */
+static void dpm_note_dep(struct device *dev, struct device *dep, ktime_t end)
+{
+	if (!dep || end.tv64 < dpm_transition_start.tv64 ||
+	    end.tv64 <= dev->power.pm_blocker_end.tv64)
+		return;
+
+	dev->power.pm_blocker = dep;
+	dev->power.pm_blocker_end = end;
+}
+
+/**
+ * dpm_wait_dep - Wait for a device another device depends on.
+ * @dev: Device being handled.
+ * @dep: Device to wait for.
+ * @async: If unset, wait only if the @dep's power.async_suspend flag is set.
+ */
+static void dpm_wait_dep(struct device *dev, struct device *dep, bool async)
+{
+	if (!dep)
+		return;
+
+	dpm_wait(dep, async);
+	dpm_note_dep(dev, dep, dep->power.pm_end);
+}
+
+/* Called before and after the callbacks of a device are run. */
+static void dpm_callbacks_start(struct device *dev, bool async)
+{
+	if (!async)
+		dpm_note_dep(dev, dpm_last_sync, dpm_last_sync_end);
+	dev->power.pm_start = ktime_get();
+}
+
+static void dpm_callbacks_end(struct device *dev, bool async)
+{
+	dev->power.pm_end = ktime_get();
+	if (!async) {
+		dpm_last_sync = dev;
+		dpm_last_sync_end = dev->power.pm_end;
+	}
+}
+
+struct dpm_wait_data {
+	struct device *dev;
+	bool async;
+};
+
+static int dpm_wait_fn(struct device *child, void *data)
+{
+	struct dpm_wait_data *wd = data;
+
+	dpm_wait_dep(wd->dev, child, wd->async);
 	return 0;
 }
 
 static void dpm_wait_for_children(struct device *dev, bool async)
 {
-       device_for_each_child(dev, &async, dpm_wait_fn);
+	struct dpm_wait_data wd = { .dev = dev, .async = async };
+
+	device_for_each_child(dev, &wd, dpm_wait_fn);
 }
 
 /**
@@ -467,6 +548,64 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
 		usecs / USEC_PER_MSEC, usecs % USEC_PER_MSEC);
 }
 
+#define DPM_CRITICAL_PATH_MAX	16
+
+static struct device *dpm_find_device(struct list_head *list,
+				      struct device *dev)
+{
+	struct device *d;
+
+	if (!dev)
+		return NULL;
+
+	list_for_each_entry(d, list, power.entry)
+		if (d == dev)
+			return d;
+
+	return NULL;
+}
+
+/**
+ * dpm_show_critical_path - Log the chain of devices that bounded a transition.
+ * @list: Devices handled in the transition.
+ * @state: PM transition of the system being carried out.
+ *
+ * Start from the device that was done last and follow, for each device, the
+ * dependency it was held back by: its parent or a child, a device passed to
+ * device_pm_wait_for_dev() or the synchronous device handled before it.
+ * The transition cannot complete faster than this chain, whatever is made
+ * asynchronous elsewhere.
+ *
+ * Must be called with dpm_list_mtx held.
+ */
+static void dpm_show_critical_path(struct list_head *list, pm_message_t state)
+{
+	struct device *dev, *last = NULL;
+	ktime_t start = dpm_transition_start;
+	int n;
+
+	if (!pm_print_critical_path)
+		return;
+
+	list_for_each_entry(dev, list, power.entry) {
+		if (dev->power.pm_end.tv64 < start.tv64)
+			continue;
+		if (!last || dev->power.pm_end.tv64 > last->power.pm_end.tv64)
+			last = dev;
+	}
+
+	pr_info("PM: %s critical path, last device first:\n",
+		pm_verb(state.event));
+	for (n = 0; last && n < DPM_CRITICAL_PATH_MAX; n++) {
+		pr_info("PM:   %s %s: started at +%lld, took %lld usecs\n",
+			dev_driver_string(last), dev_name(last),
+			ktime_us_delta(last->power.pm_start, start),
+			ktime_us_delta(last->power.pm_end,
+				       last->power.pm_start));
+		last = dpm_find_device(list, last->power.pm_blocker);
+	}
+}
+
 /*------------------------- Resume routines -------------------------*/
 
 /**
@@ -581,7 +720,8 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	TRACE_RESUME(0);
 
 	if (dev->parent && dev->parent->power.in_suspend)
-		dpm_wait(dev->parent, async);
+		dpm_wait_dep(dev, dev->parent, async);
+	dpm_callbacks_start(dev, async);
 	device_lock(dev);
 
 	dev->power.in_suspend = false;
@@ -618,6 +758,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	}
  End:
 	device_unlock(dev);
+	dpm_callbacks_end(dev, async);
 	complete_all(&dev->power.completion);
 
 	TRACE_RESUME(error);
@@ -680,9 +821,11 @@ static void dpm_resume(pm_message_t state)
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
 	async_error = 0;
+	dpm_start_transition();
 
 	list_for_each_entry(dev, &dpm_suspended_list, power.entry) {
 		INIT_COMPLETION(dev->power.completion);
+		dpm_reset_timing(dev);
 		if (is_async(dev)) {
 			get_device(dev);
 			async_schedule(async_resume, dev);
@@ -718,6 +861,10 @@ static void dpm_resume(pm_message_t state)
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
 	dpm_show_time(starttime, state, NULL);
+
+	mutex_lock(&dpm_list_mtx);
+	dpm_show_critical_path(&dpm_prepared_list, state);
+	mutex_unlock(&dpm_list_mtx);
 }
 
 /**
@@ -928,6 +1075,7 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	struct dpm_drv_wd_data data;
 
 	dpm_wait_for_children(dev, async);
+	dpm_callbacks_start(dev, async);
 
 	data.dev = dev;
 	data.tsk = get_current();
@@ -984,6 +1132,7 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	del_timer_sync(&timer);
 	destroy_timer_on_stack(&timer);
 
+	dpm_callbacks_end(dev, async);
 	complete_all(&dev->power.completion);
 
 	if (error)
@@ -1007,6 +1156,7 @@ static void async_suspend(void *data, async_cookie_t cookie)
 static int device_suspend(struct device *dev)
 {
 	INIT_COMPLETION(dev->power.completion);
+	dpm_reset_timing(dev);
 
 	if (pm_async_enabled && dev->power.async_suspend) {
 		get_device(dev);
@@ -1029,6 +1179,7 @@ static int dpm_suspend(pm_message_t state)
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
 	async_error = 0;
+	dpm_start_transition();
 	while (!list_empty(&dpm_prepared_list)) {
 		struct device *dev = to_device(dpm_prepared_list.prev);
 
@@ -1053,8 +1204,12 @@ static int dpm_suspend(pm_message_t state)
 	async_synchronize_full();
 	if (!error)
 		error = async_error;
-	if (!error)
+	if (!error) {
 		dpm_show_time(starttime, state, NULL);
+		mutex_lock(&dpm_list_mtx);
+		dpm_show_critical_path(&dpm_suspended_list, state);
+		mutex_unlock(&dpm_list_mtx);
+	}
 	return error;
 }
 
@@ -1182,7 +1337,7 @@ EXPORT_SYMBOL_GPL(__suspend_report_result);
  */
 int device_pm_wait_for_dev(struct device *subordinate, struct device *dev)
 {
-	dpm_wait(dev, subordinate->power.async_suspend);
+	dpm_wait_dep(subordinate, dev, subordinate->power.async_suspend);
 	return async_error;
 }
 EXPORT_SYMBOL_GPL(device_pm_wait_for_dev);
@@ -14,6 +14,7 @@ static inline void pm_runtime_remove(struct device *dev) {}
 
 /* kernel/power/main.c */
 extern int pm_async_enabled;
+extern int pm_print_critical_path;
 
 /* drivers/base/power/main.c */
 extern struct list_head dpm_list;	/* The active device list */
@@ -28,6 +28,9 @@
 
 #include <asm/cputime.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/cpufreq_interactive.h>
+
 static void (*pm_idle_old)(void);
 static atomic_t active_count = ATOMIC_INIT(0);
 
@@ -44,6 +47,7 @@ struct cpufreq_interactive_cpuinfo {
 	struct cpufreq_frequency_table *freq_table;
 	unsigned int target_freq;
 	int governor_enabled;
+	int load_migrated;
 };
 
 static DEFINE_PER_CPU(struct cpufreq_interactive_cpuinfo, cpuinfo);
@@ -245,10 +249,12 @@ static void cpufreq_interactive_timer(unsigned long data)
 	/*
 	 * Choose greater of short-term load (since last idle timer
 	 * started or timer function re-armed itself) or long-term load
-	 * (since last frequency change).
+	 * (since last frequency change), unless the scheduler has since
+	 * moved the work that made up the long-term load elsewhere.
 	 */
-	if (load_since_change > cpu_load)
+	if (load_since_change > cpu_load && !pcpu->load_migrated)
 		cpu_load = load_since_change;
+	pcpu->load_migrated = 0;
 
 	if (cpu_load >= go_maxspeed_load)
 		new_freq = pcpu->policy->max;
@@ -337,6 +343,71 @@ exit:
 	return;
 }
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+/*
+ * Scheduler utilization hook. Runs on wakeup, migration and tick, so a
+ * burst of work raises the speed as soon as the task that causes it is
+ * enqueued instead of one sample period later. Only increases are made
+ * here; decreases are left to the timer and min_sample_time, which is
+ * told to ignore the long-term load when that load migrated away.
+ */
+static void cpufreq_interactive_sched_util(int cpu, unsigned long util,
+					   unsigned int flags)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
+	unsigned int new_freq;
+	unsigned int old_freq;
+	unsigned int index;
+	unsigned long irqflags;
+
+	smp_rmb();
+
+	if (!pcpu->governor_enabled)
+		return;
+
+	/* only the cpu the work left discounts its long-term load */
+	if (flags & SCHED_UTIL_MIGRATE_OUT) {
+		pcpu->load_migrated = 1;
+		return;
+	}
+
+	old_freq = pcpu->target_freq;
+	if (old_freq == pcpu->policy->max)
+		return;
+
+	if (util * 100 >= go_maxspeed_load * SCHED_LOAD_SCALE)
+		new_freq = pcpu->policy->max;
+	else
+		new_freq = (pcpu->policy->max * util) >> SCHED_LOAD_SHIFT;
+
+	if (new_freq <= old_freq)
+		return;
+
+	if (cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
+					   new_freq, CPUFREQ_RELATION_H,
+					   &index))
+		return;
+
+	new_freq = pcpu->freq_table[index].frequency;
+	if (new_freq <= old_freq)
+		return;
+
+	trace_cpufreq_interactive_sched_ramp(cpu, util, flags, old_freq,
+					     new_freq);
+	dbgpr("sched %d: util=%lu flags=%#x cur=%d tgt=%d queue\n", cpu,
+	      util, flags, old_freq, new_freq);
+
+	pcpu->target_freq = new_freq;
+#if DEBUG
+	up_request_time = ktime_to_us(ktime_get());
+#endif
+	spin_lock_irqsave(&up_cpumask_lock, irqflags);
+	cpumask_set_cpu(cpu, &up_cpumask);
+	spin_unlock_irqrestore(&up_cpumask_lock, irqflags);
+	wake_up_process(up_task);
+}
+#endif
+
 static void cpufreq_interactive_idle(void)
 {
 	struct cpufreq_interactive_cpuinfo *pcpu =
@@ -490,6 +561,8 @@ static int cpufreq_interactive_up_task(void *data)
 			pcpu->freq_change_time_in_idle =
 				get_cpu_idle_time_us(cpu,
 						     &pcpu->freq_change_time);
+			trace_cpufreq_interactive_up(cpu, pcpu->target_freq,
+						     pcpu->policy->cur);
 			dbgpr("up %d: set tgt=%d (actual=%d)\n", cpu, pcpu->target_freq, pcpu->policy->cur);
 		}
 	}
@@ -602,6 +675,9 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *new_policy,
 
 		pm_idle_old = pm_idle;
 		pm_idle = cpufreq_interactive_idle;
+#ifdef CONFIG_SCHED_FREQ_INPUT
+		sched_register_util_hook(cpufreq_interactive_sched_util);
+#endif
 		break;
 
 	case CPUFREQ_GOV_STOP:
@@ -620,6 +696,9 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *new_policy,
 		if (atomic_dec_return(&active_count) > 0)
 			return 0;
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+		sched_unregister_util_hook(cpufreq_interactive_sched_util);
+#endif
 		sysfs_remove_group(cpufreq_global_kobject,
 				&interactive_attr_group);
 
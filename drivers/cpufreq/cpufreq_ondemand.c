@@ -613,6 +613,15 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 
 		load = 100 * (wall_time - idle_time) / wall_time;
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+		/*
+		 * Work that just migrated here is not yet in this cpu's
+		 * idle statistics; count the demand it carried along.
+		 */
+		load = max_t(unsigned int, load,
+			     (sched_cpu_demand(j) * 100) >> SCHED_LOAD_SHIFT);
+#endif
+
 		freq_avg = __cpufreq_driver_getavg(policy, j);
 		if (freq_avg <= 0)
 			freq_avg = policy->cur;
@@ -165,12 +165,12 @@ static const struct block_device_operations mmc_bdops = {
 	.owner			= THIS_MODULE,
 };
 
-struct mmc_blk_request {
-	struct mmc_request	mrq;
-	struct mmc_command	sbc;
-	struct mmc_command	cmd;
-	struct mmc_command	stop;
-	struct mmc_data		data;
+enum mmc_blk_status {
+	MMC_BLK_SUCCESS = 0,
+	MMC_BLK_PARTIAL,
+	MMC_BLK_RETRY_SINGLE,
+	MMC_BLK_DATA_ERR,
+	MMC_BLK_CMD_ERR,
 };
 
 static u32 mmc_sd_num_wr_blocks(struct mmc_card *card)
@@ -370,12 +370,174 @@ static inline void mmc_apply_rel_rw(struct mmc_blk_request *brq,
 	}
 }
 
-static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
+static int mmc_blk_err_check(struct mmc_card *card,
+			     struct mmc_async_req *areq)
 {
+	struct mmc_queue_req *mq_mrq = container_of(areq, struct mmc_queue_req,
+						    mmc_active);
+	struct mmc_blk_request *brq = &mq_mrq->brq;
+	struct request *req = mq_mrq->req;
+	struct mmc_command cmd;
+	unsigned int expected;
+	u32 status = 0;
+
+	/*
+	 * Check for errors here, but don't report them until later as
+	 * we need to wait for the card to leave programming mode even
+	 * when things go wrong.
+	 */
+	if (brq->sbc.error || brq->cmd.error ||
+	    brq->data.error || brq->stop.error) {
+		if (brq->data.blocks > 1 && rq_data_dir(req) == READ) {
+			/* Redo read one sector at a time */
+			printk(KERN_WARNING "%s: retrying using single "
+			       "block read\n", req->rq_disk->disk_name);
+			return MMC_BLK_RETRY_SINGLE;
+		}
+		status = get_card_status(card, req);
+	}
+
+	if (brq->sbc.error) {
+		printk(KERN_ERR "%s: error %d sending SET_BLOCK_COUNT "
+		       "command, response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->sbc.error,
+		       brq->sbc.resp[0], status);
+	}
+
+	if (brq->cmd.error) {
+		printk(KERN_ERR "%s: error %d sending read/write "
+		       "command, response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->cmd.error,
+		       brq->cmd.resp[0], status);
+	}
+
+	if (brq->data.error) {
+		if (brq->data.error == -ETIMEDOUT && brq->mrq.stop)
+			/* 'Stop' response contains card status */
+			status = brq->mrq.stop->resp[0];
+		printk(KERN_ERR "%s: error %d transferring data,"
+		       " sector %u, nr %u, card status %#x\n",
+		       req->rq_disk->disk_name, brq->data.error,
+		       (unsigned)blk_rq_pos(req),
+		       (unsigned)blk_rq_sectors(req), status);
+	}
+
+	if (brq->stop.error) {
+		printk(KERN_ERR "%s: error %d sending stop command, "
+		       "response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->stop.error,
+		       brq->stop.resp[0], status);
+	}
+
+	if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ) {
+		do {
+			int err;
+
+			memset(&cmd, 0, sizeof(struct mmc_command));
+			cmd.opcode = MMC_SEND_STATUS;
+			cmd.arg = card->rca << 16;
+			cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+			err = mmc_wait_for_cmd(card->host, &cmd, 5);
+			if (err) {
+				printk(KERN_ERR "%s: error %d requesting status\n",
+				       req->rq_disk->disk_name, err);
+				return MMC_BLK_CMD_ERR;
+			}
+			/*
+			 * Some cards mishandle the status bits,
+			 * so make sure to check both the busy
+			 * indication and the card state.
+			 */
+		} while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
+			(R1_CURRENT_STATE(cmd.resp[0]) == 7));
+	}
+
+	if (brq->cmd.error || brq->stop.error || brq->data.error) {
+		/*
+		 * After an error, we redo I/O one sector at a time,
+		 * so we only reach here for reads after trying to
+		 * read a single sector.
+		 */
+		if (rq_data_dir(req) == READ)
+			return MMC_BLK_DATA_ERR;
+		return MMC_BLK_CMD_ERR;
+	}
+
+	/*
+	 * Anything short of the whole request is reported as an error
+	 * to mmc_start_req() so that the next request is not started
+	 * before the remainder of this one has been reissued.
+	 */
+	if (mq_mrq->packed_cmd != MMC_PACKED_NONE)
+		expected = brq->data.blocks * brq->data.blksz;
+	else
+		expected = blk_rq_bytes(req);
+	if (brq->data.bytes_xfered != expected)
+		return MMC_BLK_PARTIAL;
+
+	return MMC_BLK_SUCCESS;
+}
+
+/*
+ * A packed write reports a failed entry through the exception event bit
+ * of the card status; the index of that entry is read from EXT_CSD so
+ * that the entries before it can be completed.
+ */
+static int mmc_blk_packed_err_check(struct mmc_card *card,
+				    struct mmc_async_req *areq)
+{
+	struct mmc_queue_req *mq_rq = container_of(areq, struct mmc_queue_req,
+						   mmc_active);
+	struct request *req = mq_rq->req;
+	int check;
+	u32 status;
+	u8 *ext_csd;
+
+	mq_rq->packed_fail_idx = -1;
+
+	check = mmc_blk_err_check(card, areq);
+	if (mq_rq->packed_cmd != MMC_PACKED_WRITE)
+		return check;
+
+	status = get_card_status(card, req);
+	if (!(status & R1_EXCEPTION_EVENT))
+		return check;
+
+	ext_csd = kmalloc(512, GFP_KERNEL);
+	if (!ext_csd)
+		return MMC_BLK_CMD_ERR;
+
+	if (mmc_send_ext_csd(card, ext_csd)) {
+		printk(KERN_ERR "%s: error reading EXT_CSD after packed "
+		       "write\n", req->rq_disk->disk_name);
+		check = MMC_BLK_CMD_ERR;
+	} else if ((ext_csd[EXT_CSD_EXP_EVENTS_STATUS] &
+		    EXT_CSD_PACKED_FAILURE) &&
+		   (ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+		    EXT_CSD_PACKED_GENERIC_ERROR)) {
+		if (ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+		    EXT_CSD_PACKED_INDEXED_ERROR)
+			mq_rq->packed_fail_idx =
+				ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] - 1;
+		printk(KERN_ERR "%s: packed write of %u requests failed "
+		       "at entry %d\n", req->rq_disk->disk_name,
+		       mq_rq->packed_num, mq_rq->packed_fail_idx);
+		check = MMC_BLK_CMD_ERR;
+	}
+
+	kfree(ext_csd);
+	return check;
+}
+
+static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
+			       struct mmc_card *card,
+			       int disable_multi,
+			       struct mmc_queue *mq)
+{
+	u32 readcmd, writecmd;
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
 	struct mmc_blk_data *md = mq->data;
-	struct mmc_card *card = md->queue.card;
-	struct mmc_blk_request brq;
-	int ret = 1, disable_multi = 0;
 
 	/*
 	 * Reliable writes are used to implement Forced Unit Access and
@@ -386,233 +548,483 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 		(rq_data_dir(req) == WRITE) &&
 		(md->flags & MMC_BLK_REL_WR);
 
-	mmc_claim_host(card->host);
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
 
-	do {
-		struct mmc_command cmd;
-		u32 readcmd, writecmd, status = 0;
-
-		memset(&brq, 0, sizeof(struct mmc_blk_request));
-		brq.mrq.cmd = &brq.cmd;
-		brq.mrq.data = &brq.data;
-
-		brq.cmd.arg = blk_rq_pos(req);
-		if (!mmc_card_blockaddr(card))
-			brq.cmd.arg <<= 9;
-		brq.cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
-		brq.data.blksz = 512;
-		brq.stop.opcode = MMC_STOP_TRANSMISSION;
-		brq.stop.arg = 0;
-		brq.stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
-		brq.data.blocks = blk_rq_sectors(req);
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+	brq->data.blksz = 512;
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+	brq->data.blocks = blk_rq_sectors(req);
 
-		/*
-		 * The block layer doesn't support all sector count
-		 * restrictions, so we need to be prepared for too big
-		 * requests.
-		 */
-		if (brq.data.blocks > card->host->max_blk_count)
-			brq.data.blocks = card->host->max_blk_count;
+	/*
+	 * The block layer doesn't support all sector count
+	 * restrictions, so we need to be prepared for too big
+	 * requests.
+	 */
+	if (brq->data.blocks > card->host->max_blk_count)
+		brq->data.blocks = card->host->max_blk_count;
 
-		/*
-		 * After a read error, we redo the request one sector at a time
-		 * in order to accurately determine which sectors can be read
-		 * successfully.
-		 */
-		if (disable_multi && brq.data.blocks > 1)
-			brq.data.blocks = 1;
+	/*
+	 * After a read error, we redo the request one sector at a time
+	 * in order to accurately determine which sectors can be read
+	 * successfully.
+	 */
+	if (disable_multi && brq->data.blocks > 1)
+		brq->data.blocks = 1;
 
-		if (brq.data.blocks > 1 || do_rel_wr) {
-			/* SPI multiblock writes terminate using a special
-			 * token, not a STOP_TRANSMISSION request.
-			 */
-			if (!mmc_host_is_spi(card->host) ||
-			    rq_data_dir(req) == READ)
-				brq.mrq.stop = &brq.stop;
-			readcmd = MMC_READ_MULTIPLE_BLOCK;
-			writecmd = MMC_WRITE_MULTIPLE_BLOCK;
-		} else {
-			brq.mrq.stop = NULL;
-			readcmd = MMC_READ_SINGLE_BLOCK;
-			writecmd = MMC_WRITE_BLOCK;
-		}
-		if (rq_data_dir(req) == READ) {
-			brq.cmd.opcode = readcmd;
-			brq.data.flags |= MMC_DATA_READ;
-		} else {
-			brq.cmd.opcode = writecmd;
-			brq.data.flags |= MMC_DATA_WRITE;
-		}
+	if (brq->data.blocks > 1 || do_rel_wr) {
+		/* SPI multiblock writes terminate using a special
+		 * token, not a STOP_TRANSMISSION request.
+		 */
+		if (!mmc_host_is_spi(card->host) ||
+		    rq_data_dir(req) == READ)
+			brq->mrq.stop = &brq->stop;
+		readcmd = MMC_READ_MULTIPLE_BLOCK;
+		writecmd = MMC_WRITE_MULTIPLE_BLOCK;
+	} else {
+		brq->mrq.stop = NULL;
+		readcmd = MMC_READ_SINGLE_BLOCK;
+		writecmd = MMC_WRITE_BLOCK;
+	}
+	if (rq_data_dir(req) == READ) {
+		brq->cmd.opcode = readcmd;
+		brq->data.flags |= MMC_DATA_READ;
+	} else {
+		brq->cmd.opcode = writecmd;
+		brq->data.flags |= MMC_DATA_WRITE;
+	}
 
-		if (do_rel_wr)
-			mmc_apply_rel_rw(&brq, card, req);
+	if (do_rel_wr)
+		mmc_apply_rel_rw(brq, card, req);
 
-		/*
-		 * Pre-defined multi-block transfers are preferable to
-		 * open ended-ones (and necessary for reliable writes).
-		 * However, it is not sufficient to just send CMD23,
-		 * and avoid the final CMD12, as on an error condition
-		 * CMD12 (stop) needs to be sent anyway. This, coupled
-		 * with Auto-CMD23 enhancements provided by some
-		 * hosts, means that the complexity of dealing
-		 * with this is best left to the host. If CMD23 is
-		 * supported by card and host, we'll fill sbc in and let
-		 * the host deal with handling it correctly. This means
-		 * that for hosts that don't expose MMC_CAP_CMD23, no
-		 * change of behavior will be observed.
-		 *
-		 * N.B: Some MMC cards experience perf degradation.
-		 * We'll avoid using CMD23-bounded multiblock writes for
-		 * these, while retaining features like reliable writes.
-		 */
+	/*
+	 * Pre-defined multi-block transfers are preferable to
+	 * open ended-ones (and necessary for reliable writes).
+	 * However, it is not sufficient to just send CMD23,
+	 * and avoid the final CMD12, as on an error condition
+	 * CMD12 (stop) needs to be sent anyway. This, coupled
+	 * with Auto-CMD23 enhancements provided by some
+	 * hosts, means that the complexity of dealing
+	 * with this is best left to the host. If CMD23 is
+	 * supported by card and host, we'll fill sbc in and let
+	 * the host deal with handling it correctly. This means
+	 * that for hosts that don't expose MMC_CAP_CMD23, no
+	 * change of behavior will be observed.
+	 *
+	 * N.B: Some MMC cards experience perf degradation.
+	 * We'll avoid using CMD23-bounded multiblock writes for
+	 * these, while retaining features like reliable writes.
+	 */
 
-		if ((md->flags & MMC_BLK_CMD23) &&
-		    mmc_op_multi(brq.cmd.opcode) &&
-		    (do_rel_wr || !(card->quirks & MMC_QUIRK_BLK_NO_CMD23))) {
-			brq.sbc.opcode = MMC_SET_BLOCK_COUNT;
-			brq.sbc.arg = brq.data.blocks |
-				(do_rel_wr ? (1 << 31) : 0);
-			brq.sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
-			brq.mrq.sbc = &brq.sbc;
-		}
+	if ((md->flags & MMC_BLK_CMD23) &&
+	    mmc_op_multi(brq->cmd.opcode) &&
+	    (do_rel_wr || !(card->quirks & MMC_QUIRK_BLK_NO_CMD23))) {
+		brq->sbc.opcode = MMC_SET_BLOCK_COUNT;
+		brq->sbc.arg = brq->data.blocks |
+			(do_rel_wr ? (1 << 31) : 0);
+		brq->sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+		brq->mrq.sbc = &brq->sbc;
+	}
 
-		mmc_set_data_timeout(&brq.data, card);
+	mmc_set_data_timeout(&brq->data, card);
 
-		brq.data.sg = mq->sg;
-		brq.data.sg_len = mmc_queue_map_sg(mq);
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
 
-		/*
-		 * Adjust the sg list so it is the same size as the
-		 * request.
-		 */
-		if (brq.data.blocks != blk_rq_sectors(req)) {
-			int i, data_size = brq.data.blocks << 9;
-			struct scatterlist *sg;
-
-			for_each_sg(brq.data.sg, sg, brq.data.sg_len, i) {
-				data_size -= sg->length;
-				if (data_size <= 0) {
-					sg->length += data_size;
-					i++;
-					break;
-				}
+	/*
+	 * Adjust the sg list so it is the same size as the
+	 * request.
+	 */
+	if (brq->data.blocks != blk_rq_sectors(req)) {
+		int i, data_size = brq->data.blocks << 9;
+		struct scatterlist *sg;
+
+		for_each_sg(brq->data.sg, sg, brq->data.sg_len, i) {
+			data_size -= sg->length;
+			if (data_size <= 0) {
+				sg->length += data_size;
+				i++;
+				break;
 			}
-			brq.data.sg_len = i;
 		}
+		brq->data.sg_len = i;
+	}
 
-		mmc_queue_bounce_pre(mq);
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_err_check;
 
-		mmc_wait_for_req(card->host, &brq.mrq);
+	mmc_queue_bounce_pre(mqrq);
+}
 
-		mmc_queue_bounce_post(mq);
+static inline bool mmc_blk_can_pack(struct request *req)
+{
+	return rq_data_dir(req) == WRITE &&
+	       !(req->cmd_flags & (REQ_DISCARD | REQ_FLUSH |
+				   REQ_FUA | REQ_META));
+}
 
-		/*
-		 * Check for errors here, but don't jump to cmd_err
-		 * until later as we need to wait for the card to leave
-		 * programming mode even when things go wrong.
-		 */
-		if (brq.sbc.error || brq.cmd.error ||
-		    brq.data.error || brq.stop.error) {
-			if (brq.data.blocks > 1 && rq_data_dir(req) == READ) {
-				/* Redo read one sector at a time */
-				printk(KERN_WARNING "%s: retrying using single "
-				       "block read\n", req->rq_disk->disk_name);
-				disable_multi = 1;
-				continue;
-			}
-			status = get_card_status(card, req);
-		} else if (disable_multi == 1) {
-			disable_multi = 0;
-		}
+static void mmc_blk_update_pack_stats(struct mmc_card *card,
+				      enum mmc_packed_cmd cmd,
+				      unsigned int num)
+{
+	struct mmc_wr_pack_stats *stats = &card->wr_pack_stats;
+
+	spin_lock(&stats->lock);
+	switch (cmd) {
+	case MMC_PACKED_NONE:
+		stats->single++;
+		break;
+	case MMC_PACKED_WRITE:
+		stats->packed++;
+		stats->packed_reqs += num;
+		break;
+	case MMC_PACKED_MERGE:
+		stats->merged++;
+		stats->merged_reqs += num;
+		break;
+	}
+	if (num > stats->max_depth)
+		stats->max_depth = num;
+	spin_unlock(&stats->lock);
+}
 
-		if (brq.sbc.error) {
-			printk(KERN_ERR "%s: error %d sending SET_BLOCK_COUNT "
-			       "command, response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.sbc.error,
-			       brq.sbc.resp[0], status);
-		}
+/*
+ * Pull further writes off the queue to go to the card together with
+ * the write in @mqrq as one transfer.  With eMMC 4.5 packed commands
+ * any queued write qualifies.  Otherwise only writes that carry on
+ * where the previous one ends are taken and issued as one CMD25; the
+ * elevator leaves those unmerged when they come from different queues
+ * (CFQ keeps sync and async writes apart, for instance).
+ */
+static void mmc_blk_prep_packed_list(struct mmc_queue *mq,
+				     struct mmc_queue_req *mqrq)
+{
+	struct request_queue *q = mq->queue;
+	struct mmc_card *card = mq->card;
+	struct request *req = mqrq->req, *cur = req, *next;
+	enum mmc_packed_cmd cmd;
+	unsigned int max_num, max_blocks, max_segs;
+	unsigned int blocks, segs, num = 1;
 
-		if (brq.cmd.error) {
-			printk(KERN_ERR "%s: error %d sending read/write "
-			       "command, response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.cmd.error,
-			       brq.cmd.resp[0], status);
-		}
+	mqrq->packed_cmd = MMC_PACKED_NONE;
+	mqrq->packed_num = 0;
 
-		if (brq.data.error) {
-			if (brq.data.error == -ETIMEDOUT && brq.mrq.stop)
-				/* 'Stop' response contains card status */
-				status = brq.mrq.stop->resp[0];
-			printk(KERN_ERR "%s: error %d transferring data,"
-			       " sector %u, nr %u, card status %#x\n",
-			       req->rq_disk->disk_name, brq.data.error,
-			       (unsigned)blk_rq_pos(req),
-			       (unsigned)blk_rq_sectors(req), status);
-		}
+	if (rq_data_dir(req) != WRITE)
+		return;
+
+	if (mqrq->bounce_buf || !mmc_blk_can_pack(req))
+		goto out;
+
+	max_blocks = queue_max_hw_sectors(q);
+	max_segs = card->host->max_segs;
+	if (mqrq->packed_hdr) {
+		cmd = MMC_PACKED_WRITE;
+		max_num = min_t(unsigned int, card->ext_csd.max_packed_writes,
+				MMC_PACKED_MAX_ENTRIES);
+		/* The header takes a block and a segment of its own */
+		max_blocks--;
+		max_segs--;
+	} else {
+		cmd = MMC_PACKED_MERGE;
+		max_num = MMC_PACKED_MAX_ENTRIES;
+	}
+
+	blocks = blk_rq_sectors(req);
+	segs = req->nr_phys_segments;
+
+	spin_lock_irq(q->queue_lock);
+	while (num < max_num) {
+		next = blk_peek_request(q);
+		if (!next || !mmc_blk_can_pack(next))
+			break;
+
+		if (cmd == MMC_PACKED_MERGE &&
+		    blk_rq_pos(next) != blk_rq_pos(cur) + blk_rq_sectors(cur))
+			break;
+
+		if (blocks + blk_rq_sectors(next) > max_blocks ||
+		    segs + next->nr_phys_segments > max_segs)
+			break;
+
+		blk_start_request(next);
+		if (num == 1)
+			list_add_tail(&req->queuelist, &mqrq->packed_list);
+		list_add_tail(&next->queuelist, &mqrq->packed_list);
+
+		blocks += blk_rq_sectors(next);
+		segs += next->nr_phys_segments;
+		cur = next;
+		num++;
+	}
+	spin_unlock_irq(q->queue_lock);
+
+	if (num > 1) {
+		mqrq->packed_cmd = cmd;
+		mqrq->packed_num = num;
+	}
+ out:
+	mmc_blk_update_pack_stats(card, mqrq->packed_cmd, num);
+}
 
-		if (brq.stop.error) {
-			printk(KERN_ERR "%s: error %d sending stop command, "
-			       "response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.stop.error,
-			       brq.stop.resp[0], status);
+static void mmc_blk_packed_rq_prep(struct mmc_queue_req *mqrq,
+				   struct mmc_card *card,
+				   struct mmc_queue *mq)
+{
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req, *prq;
+	struct mmc_blk_data *md = mq->data;
+	__le32 *hdr = mqrq->packed_hdr;
+	unsigned int hdr_blocks = 0;
+	int i = 1;
+
+	if (mqrq->packed_cmd == MMC_PACKED_WRITE) {
+		memset(hdr, 0, MMC_PACKED_HDR_SIZE);
+		hdr[0] = cpu_to_le32(MMC_PACKED_HDR(MMC_PACKED_CMD_WR,
+						    mqrq->packed_num));
+		hdr_blocks = 1;
+	}
+
+	mqrq->packed_blocks = 0;
+	list_for_each_entry(prq, &mqrq->packed_list, queuelist) {
+		if (hdr_blocks) {
+			/* Arguments of the CMD23 and CMD25 for this entry */
+			hdr[i * 2] = cpu_to_le32(blk_rq_sectors(prq));
+			hdr[i * 2 + 1] = cpu_to_le32(mmc_card_blockaddr(card) ?
+						     blk_rq_pos(prq) :
+						     blk_rq_pos(prq) << 9);
+			i++;
 		}
+		mqrq->packed_blocks += blk_rq_sectors(prq);
+	}
 
-		if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ) {
-			do {
-				int err;
-
-				cmd.opcode = MMC_SEND_STATUS;
-				cmd.arg = card->rca << 16;
-				cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
-				err = mmc_wait_for_cmd(card->host, &cmd, 5);
-				if (err) {
-					printk(KERN_ERR "%s: error %d requesting status\n",
-					       req->rq_disk->disk_name, err);
-					goto cmd_err;
-				}
-				/*
-				 * Some cards mishandle the status bits,
-				 * so make sure to check both the busy
-				 * indication and the card state.
-				 */
-			} while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
-				(R1_CURRENT_STATE(cmd.resp[0]) == 7));
-
-#if 0
-			if (cmd.resp[0] & ~0x00000900)
-				printk(KERN_ERR "%s: status = %08x\n",
-				       req->rq_disk->disk_name, cmd.resp[0]);
-			if (mmc_decode_status(cmd.resp))
-				goto cmd_err;
-#endif
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+
+	brq->cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+	brq->data.blksz = 512;
+	brq->data.blocks = mqrq->packed_blocks + hdr_blocks;
+	brq->data.flags |= MMC_DATA_WRITE;
+
+	/* SPI multiblock writes end with a stop token, not CMD12 */
+	if (!mmc_host_is_spi(card->host))
+		brq->mrq.stop = &brq->stop;
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+
+	if (mqrq->packed_cmd == MMC_PACKED_WRITE ||
+	    ((md->flags & MMC_BLK_CMD23) &&
+	     !(card->quirks & MMC_QUIRK_BLK_NO_CMD23))) {
+		brq->sbc.opcode = MMC_SET_BLOCK_COUNT;
+		brq->sbc.arg = brq->data.blocks;
+		if (mqrq->packed_cmd == MMC_PACKED_WRITE)
+			brq->sbc.arg |= MMC_CMD23_ARG_PACKED;
+		brq->sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+		brq->mrq.sbc = &brq->sbc;
+	}
+
+	mmc_set_data_timeout(&brq->data, card);
+
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_packed_map_sg(mq, mqrq);
+
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_packed_err_check;
+}
+
+static void mmc_blk_rq_prep(struct mmc_queue_req *mqrq,
+			    struct mmc_card *card,
+			    struct mmc_queue *mq)
+{
+	if (mqrq->packed_cmd != MMC_PACKED_NONE)
+		mmc_blk_packed_rq_prep(mqrq, card, mq);
+	else
+		mmc_blk_rw_rq_prep(mqrq, card, 0, mq);
+}
+
+/*
+ * Complete the requests of a packed or merged transfer.  Returns 0 when
+ * all of them are done.  Otherwise those the card did not write are
+ * split up again: the first is left in @mq_rq to be reissued on its own
+ * by the caller and the rest go back to the front of the queue.
+ */
+static int mmc_blk_end_packed_req(struct mmc_queue *mq,
+				  struct mmc_queue_req *mq_rq, int status)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = mq->card;
+	struct request *prq;
+	unsigned int done = 0, i;
+	bool all_done;
+
+	if (status == MMC_BLK_SUCCESS) {
+		done = mq_rq->packed_num;
+	} else if (mq_rq->packed_cmd == MMC_PACKED_WRITE) {
+		/* an index past the last entry is bogus: trust nothing */
+		if (mq_rq->packed_fail_idx > 0 &&
+		    mq_rq->packed_fail_idx < mq_rq->packed_num)
+			done = mq_rq->packed_fail_idx;
+	} else {
+		/* A merged write is written in order */
+		unsigned int blocks = mq_rq->brq.data.bytes_xfered >> 9;
+
+		list_for_each_entry(prq, &mq_rq->packed_list, queuelist) {
+			if (blk_rq_sectors(prq) > blocks)
+				break;
+			blocks -= blk_rq_sectors(prq);
+			done++;
 		}
+	}
 
-		if (brq.cmd.error || brq.stop.error || brq.data.error) {
-			if (rq_data_dir(req) == READ) {
+	spin_lock_irq(&md->lock);
+	for (i = 0; i < done; i++) {
+		prq = list_entry_rq(mq_rq->packed_list.next);
+		list_del_init(&prq->queuelist);
+		__blk_end_request(prq, 0, blk_rq_bytes(prq));
+	}
+
+	/* Requeue from the tail so that the queue keeps their order */
+	while (!list_empty(&mq_rq->packed_list)) {
+		prq = list_entry_rq(mq_rq->packed_list.prev);
+		list_del_init(&prq->queuelist);
+		if (list_empty(&mq_rq->packed_list))
+			mq_rq->req = prq;
+		else
+			blk_requeue_request(mq->queue, prq);
+	}
+	spin_unlock_irq(&md->lock);
+
+	all_done = done == mq_rq->packed_num;
+	mq_rq->packed_cmd = MMC_PACKED_NONE;
+	mq_rq->packed_num = 0;
+
+	/*
+	 * A merged write can fail after its last block was transferred;
+	 * with every request ended there is nothing left to retry.
+	 */
+	if (all_done) {
+		mq_rq->req = NULL;
+		return 0;
+	}
+
+	spin_lock(&card->wr_pack_stats.lock);
+	card->wr_pack_stats.unpacked++;
+	spin_unlock(&card->wr_pack_stats.lock);
+	return 1;
+}
+
+/*
+ * Issue @rqc (which may be NULL when only draining) and complete the
+ * request that was started on the previous call.  The card transfers
+ * the previous request while @rqc is being prepared; @rqc is left in
+ * flight when this returns.  If the previous request failed, @rqc is
+ * held back until the failed one has been retried or aborted.
+ */
+static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_blk_request *brq;
+	int ret = 1, disable_multi = 0, status;
+	struct mmc_queue_req *mq_rq;
+	struct request *req;
+	struct mmc_async_req *areq;
+	bool rqc_started;
+
+	if (!rqc && !mq->mqrq_prev->req)
+		return 0;
+
+	if (rqc) {
+		mmc_blk_prep_packed_list(mq, mq->mqrq_cur);
+		mmc_blk_rq_prep(mq->mqrq_cur, card, mq);
+		areq = &mq->mqrq_cur->mmc_active;
+	} else
+		areq = NULL;
+	areq = mmc_start_req(card->host, areq, &status);
+	if (!areq)
+		return 1;
+
+	/* mmc_start_req() only starts @rqc if the previous one succeeded */
+	rqc_started = rqc && status == MMC_BLK_SUCCESS;
+
+	do {
+		mq_rq = container_of(areq, struct mmc_queue_req, mmc_active);
+		brq = &mq_rq->brq;
+		req = mq_rq->req;
+		mmc_queue_bounce_post(mq_rq);
+
+		if (mq_rq->packed_cmd != MMC_PACKED_NONE) {
+			/*
+			 * Whatever the card did not write is retried
+			 * below one request at a time.
+			 */
+			ret = mmc_blk_end_packed_req(mq, mq_rq, status);
+			req = mq_rq->req;
+			disable_multi = 0;
+		} else {
+			switch (status) {
+			case MMC_BLK_SUCCESS:
+			case MMC_BLK_PARTIAL:
 				/*
-				 * After an error, we redo I/O one sector at a
-				 * time, so we only reach here after trying to
-				 * read a single sector.
+				 * A block was successfully transferred.
 				 */
 				spin_lock_irq(&md->lock);
-				ret = __blk_end_request(req, -EIO, brq.data.blksz);
+				ret = __blk_end_request(req, 0,
+						brq->data.bytes_xfered);
+				spin_unlock_irq(&md->lock);
+				if (status == MMC_BLK_SUCCESS && ret) {
+					/*
+					 * All data was transferred without
+					 * error but the block layer still
+					 * has more; this is a bug.
+					 */
+					printk(KERN_ERR "%s BUG rq_tot %d "
+					       "d_xfer %d\n", __func__,
+					       blk_rq_bytes(req),
+					       brq->data.bytes_xfered);
+					goto cmd_abort;
+				}
+				disable_multi = 0;
+				break;
+			case MMC_BLK_CMD_ERR:
+				goto cmd_err;
+			case MMC_BLK_RETRY_SINGLE:
+				disable_multi = 1;
+				break;
+			case MMC_BLK_DATA_ERR:
+				spin_lock_irq(&md->lock);
+				ret = __blk_end_request(req, -EIO,
+							brq->data.blksz);
 				spin_unlock_irq(&md->lock);
-				continue;
+				break;
 			}
-			goto cmd_err;
 		}
 
-		/*
-		 * A block was successfully transferred.
-		 */
-		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
-		spin_unlock_irq(&md->lock);
+		if (ret) {
+			/*
+			 * The request is not complete: prepare the rest
+			 * again and run it to completion before anything
+			 * else is started.
+			 */
+			mmc_blk_rw_rq_prep(mq_rq, card, disable_multi, mq);
+			mmc_start_req(card->host, &mq_rq->mmc_active, NULL);
+			areq = mmc_start_req(card->host, NULL, &status);
+		}
 	} while (ret);
 
-	mmc_release_host(card->host);
-
-	return 1;
+	ret = 1;
+	goto start_new_req;
 
  cmd_err:
  	/*
@@ -634,18 +1046,23 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 		}
 	} else {
 		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
+		ret = __blk_end_request(req, 0, brq->data.bytes_xfered);
 		spin_unlock_irq(&md->lock);
 	}
 
-	mmc_release_host(card->host);
-
+ cmd_abort:
 	spin_lock_irq(&md->lock);
 	while (ret)
 		ret = __blk_end_request(req, -EIO, blk_rq_cur_bytes(req));
 	spin_unlock_irq(&md->lock);
 
-	return 0;
+ start_new_req:
+	if (rqc && !rqc_started) {
+		mmc_blk_rq_prep(mq->mqrq_cur, card, mq);
+		mmc_start_req(card->host, &mq->mqrq_cur->mmc_active, NULL);
+	}
+
+	return ret;
 }
 
 static int
@@ -653,26 +1070,43 @@ mmc_blk_set_blksize(struct mmc_blk_data *md, struct mmc_card *card);
 
 static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 {
-#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
 	struct mmc_blk_data *md = mq->data;
 	struct mmc_card *card = md->queue.card;
+	int ret;
 
-	if (mmc_bus_needs_resume(card->host)) {
+#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
+	if (req && mmc_bus_needs_resume(card->host)) {
 		mmc_resume_bus(card->host);
 		mmc_blk_set_blksize(md, card);
 	}
 #endif
 
-	if (req->cmd_flags & REQ_DISCARD) {
+	if (req && !mq->mqrq_prev->req)
+		/* claim host only for the first request */
+		mmc_claim_host(card->host);
+
+	if (req && req->cmd_flags & REQ_DISCARD) {
+		/* complete ongoing async transfer before issuing discard */
+		if (card->host->areq)
+			mmc_blk_issue_rw_rq(mq, NULL);
 		if (req->cmd_flags & REQ_SECURE)
-			return mmc_blk_issue_secdiscard_rq(mq, req);
+			ret = mmc_blk_issue_secdiscard_rq(mq, req);
 		else
-			return mmc_blk_issue_discard_rq(mq, req);
-	} else if (req->cmd_flags & REQ_FLUSH) {
-		return mmc_blk_issue_flush(mq, req);
+			ret = mmc_blk_issue_discard_rq(mq, req);
+	} else if (req && req->cmd_flags & REQ_FLUSH) {
+		/* complete ongoing async transfer before issuing flush */
+		if (card->host->areq)
+			mmc_blk_issue_rw_rq(mq, NULL);
+		ret = mmc_blk_issue_flush(mq, req);
 	} else {
-		return mmc_blk_issue_rw_rq(mq, req);
+		ret = mmc_blk_issue_rw_rq(mq, req);
 	}
+
+	if (!req)
+		/* release host only when there are no more requests */
+		mmc_release_host(card->host);
+
+	return ret;
 }
 
 static inline int mmc_blk_readonly(struct mmc_card *card)
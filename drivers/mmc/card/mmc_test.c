@@ -18,6 +18,7 @@
 #include <linux/scatterlist.h>
 #include <linux/swap.h>		/* For nr_free_buffer_pages() */
 #include <linux/list.h>
+#include <linux/random.h>
 
 #include <linux/debugfs.h>
 #include <linux/uaccess.h>
@@ -1766,6 +1767,286 @@ static int mmc_test_profile_seq_trim_perf(struct mmc_test_card *test)
 	return 0;
 }
 
+/**
+ * struct mmc_test_async_req - one of the two requests kept in flight by the
+ * non-blocking performance tests.
+ * @areq: request handed to mmc_start_req()
+ * @mrq: the mmc request itself
+ * @cmd: transfer command
+ * @stop: stop command
+ * @data: data descriptor
+ * @test: test information, needed by the error check
+ */
+struct mmc_test_async_req {
+	struct mmc_async_req	areq;
+	struct mmc_request	mrq;
+	struct mmc_command	cmd;
+	struct mmc_command	stop;
+	struct mmc_data		data;
+	struct mmc_test_card	*test;
+};
+
+static int mmc_test_check_result_async(struct mmc_card *card,
+				       struct mmc_async_req *areq)
+{
+	struct mmc_test_async_req *test_async =
+		container_of(areq, struct mmc_test_async_req, areq);
+
+	mmc_test_wait_busy(test_async->test);
+
+	return mmc_test_check_result(test_async->test, areq->mrq);
+}
+
+/*
+ * Transfer the bytes mapped by mmc_test_area_map() @cnt times through
+ * mmc_start_req(), so that each transfer is prepared while the previous
+ * one is still running.  Consecutive transfers either follow each other
+ * through the test area or land on random @sz aligned offsets within it.
+ */
+static int mmc_test_nonblock_transfer(struct mmc_test_card *test,
+				      unsigned long sz, unsigned int cnt,
+				      int write, int random)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_test_async_req *rq;
+	unsigned int dev_addr = t->dev_addr;
+	unsigned int slots = t->max_sz / sz;
+	unsigned int i;
+	int ret = 0;
+
+	rq = kzalloc(2 * sizeof(struct mmc_test_async_req), GFP_KERNEL);
+	if (!rq)
+		return -ENOMEM;
+
+	for (i = 0; i < cnt; i++) {
+		struct mmc_test_async_req *cur = &rq[i & 1];
+
+		if (random)
+			dev_addr = t->dev_addr +
+				   (random32() % slots) * (sz >> 9);
+
+		memset(&cur->cmd, 0, sizeof(struct mmc_command));
+		memset(&cur->stop, 0, sizeof(struct mmc_command));
+		memset(&cur->data, 0, sizeof(struct mmc_data));
+		memset(&cur->mrq, 0, sizeof(struct mmc_request));
+		cur->mrq.cmd = &cur->cmd;
+		cur->mrq.data = &cur->data;
+		cur->mrq.stop = &cur->stop;
+		cur->areq.mrq = &cur->mrq;
+		cur->areq.err_check = mmc_test_check_result_async;
+		cur->test = test;
+
+		mmc_test_prepare_mrq(test, &cur->mrq, t->sg, t->sg_len,
+				     dev_addr, t->blocks, 512, write);
+
+		mmc_start_req(test->card->host, &cur->areq, &ret);
+		/* on error nothing is left in flight */
+		if (ret)
+			goto out;
+
+		if (!random)
+			dev_addr += sz >> 9;
+	}
+
+	mmc_start_req(test->card->host, NULL, &ret);
+out:
+	kfree(rq);
+	return ret;
+}
+
+static int mmc_test_nonblock_perf(struct mmc_test_card *test, int write,
+				  int random)
+{
+	unsigned long sz;
+	unsigned int cnt;
+	struct timespec ts1, ts2;
+	int ret;
+
+	for (sz = 512; sz <= test->area.max_tfr; sz <<= 1) {
+		if (write) {
+			ret = mmc_test_area_erase(test);
+			if (ret)
+				return ret;
+		}
+		ret = mmc_test_area_map(test, sz, 0);
+		if (ret)
+			return ret;
+		cnt = test->area.max_sz / sz;
+		getnstimeofday(&ts1);
+		ret = mmc_test_nonblock_transfer(test, sz, cnt, write, random);
+		if (ret)
+			return ret;
+		getnstimeofday(&ts2);
+		mmc_test_print_avg_rate(test, sz, cnt, &ts1, &ts2);
+	}
+	return 0;
+}
+
+/*
+ * Consecutive read performance by transfer size, two requests in flight.
+ */
+static int mmc_test_profile_seq_read_nonblock(struct mmc_test_card *test)
+{
+	return mmc_test_nonblock_perf(test, 0, 0);
+}
+
+/*
+ * Consecutive write performance by transfer size, two requests in flight.
+ */
+static int mmc_test_profile_seq_write_nonblock(struct mmc_test_card *test)
+{
+	return mmc_test_nonblock_perf(test, 1, 0);
+}
+
+/*
+ * Random read performance by transfer size, two requests in flight.
+ */
+static int mmc_test_profile_rnd_read_nonblock(struct mmc_test_card *test)
+{
+	return mmc_test_nonblock_perf(test, 0, 1);
+}
+
+/*
+ * Random write performance by transfer size, two requests in flight.
+ */
+static int mmc_test_profile_rnd_write_nonblock(struct mmc_test_card *test)
+{
+	return mmc_test_nonblock_perf(test, 1, 1);
+}
+
+/*
+ * Write @cnt chunks of @sz bytes to random @sz aligned offsets within the
+ * test area as one eMMC 4.5 packed write.  Every entry writes the same
+ * page of test memory.
+ */
+static int mmc_test_packed_write(struct mmc_test_card *test,
+				 unsigned long sz, unsigned int cnt,
+				 __le32 *hdr, struct scatterlist *sg)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_request mrq;
+	struct mmc_command sbc;
+	struct mmc_command cmd;
+	struct mmc_command stop;
+	struct mmc_data data;
+	unsigned int slots = t->max_sz / sz, blocks = sz >> 9;
+	unsigned int dev_addr, i;
+	int ret;
+
+	memset(hdr, 0, MMC_PACKED_HDR_SIZE);
+	hdr[0] = cpu_to_le32(MMC_PACKED_HDR(MMC_PACKED_CMD_WR, cnt));
+
+	sg_init_table(sg, cnt + 1);
+	sg_set_buf(&sg[0], hdr, MMC_PACKED_HDR_SIZE);
+	for (i = 0; i < cnt; i++) {
+		dev_addr = t->dev_addr + (random32() % slots) * blocks;
+		if (!mmc_card_blockaddr(test->card))
+			dev_addr <<= 9;
+		hdr[(i + 1) * 2] = cpu_to_le32(blocks);
+		hdr[(i + 1) * 2 + 1] = cpu_to_le32(dev_addr);
+		sg_set_page(&sg[i + 1], t->mem->arr[0].page, sz, 0);
+	}
+
+	memset(&mrq, 0, sizeof(struct mmc_request));
+	memset(&sbc, 0, sizeof(struct mmc_command));
+	memset(&cmd, 0, sizeof(struct mmc_command));
+	memset(&stop, 0, sizeof(struct mmc_command));
+	memset(&data, 0, sizeof(struct mmc_data));
+
+	mrq.sbc = &sbc;
+	mrq.cmd = &cmd;
+	mrq.data = &data;
+	mrq.stop = &stop;
+
+	sbc.opcode = MMC_SET_BLOCK_COUNT;
+	sbc.arg = MMC_CMD23_ARG_PACKED | (cnt * blocks + 1);
+	sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+	cmd.arg = le32_to_cpu(hdr[3]);
+	cmd.flags = MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	stop.opcode = MMC_STOP_TRANSMISSION;
+	stop.flags = MMC_RSP_R1B | MMC_CMD_AC;
+
+	data.blksz = 512;
+	data.blocks = cnt * blocks + 1;
+	data.flags = MMC_DATA_WRITE;
+	data.sg = sg;
+	data.sg_len = cnt + 1;
+	mmc_set_data_timeout(&data, test->card);
+
+	mmc_wait_for_req(test->card->host, &mrq);
+
+	if (sbc.error)
+		return sbc.error;
+
+	ret = mmc_test_wait_busy(test);
+	if (ret)
+		return ret;
+
+	return mmc_test_check_result(test, &mrq);
+}
+
+/*
+ * Random 4KiB writes, packed into commands of increasing depth.  Compare
+ * with the non-blocking random write test for the cost of one command
+ * per write.
+ */
+static int mmc_test_profile_packed_write_perf(struct mmc_test_card *test)
+{
+	struct mmc_card *card = test->card;
+	unsigned long sz = 4096;
+	unsigned int depth, max_depth, cnt, i;
+	struct timespec ts1, ts2;
+	struct scatterlist *sg;
+	__le32 *hdr;
+	int ret = 0;
+
+	if (!mmc_card_mmc(card) || !card->ext_csd.max_packed_writes)
+		return RESULT_UNSUP_CARD;
+
+	if (!mmc_host_cmd23(card->host) ||
+	    !(card->host->caps2 & MMC_CAP2_PACKED_WR))
+		return RESULT_UNSUP_HOST;
+
+	max_depth = min_t(unsigned int, card->ext_csd.max_packed_writes,
+			  MMC_PACKED_MAX_ENTRIES);
+	/* The header takes a segment of its own */
+	max_depth = min_t(unsigned int, max_depth,
+			  test->area.max_segs - 1);
+	if (!max_depth || test->area.max_sz < sz)
+		return RESULT_UNSUP_HOST;
+
+	hdr = kzalloc(MMC_PACKED_HDR_SIZE, GFP_KERNEL);
+	sg = kmalloc(sizeof(struct scatterlist) * (max_depth + 1),
+		     GFP_KERNEL);
+	if (!hdr || !sg) {
+		ret = -ENOMEM;
+		goto out_free;
+	}
+
+	for (depth = 1; depth <= max_depth; depth <<= 1) {
+		ret = mmc_test_area_erase(test);
+		if (ret)
+			goto out_free;
+		cnt = test->area.max_sz / (sz * depth);
+		getnstimeofday(&ts1);
+		for (i = 0; i < cnt; i++) {
+			ret = mmc_test_packed_write(test, sz, depth, hdr, sg);
+			if (ret)
+				goto out_free;
+		}
+		getnstimeofday(&ts2);
+		mmc_test_print_avg_rate(test, sz * depth, cnt, &ts1, &ts2);
+	}
+
+out_free:
+	kfree(sg);
+	kfree(hdr);
+	return ret;
+}
+
 static const struct mmc_test_case mmc_test_cases[] = {
 	{
 		.name = "Basic write (no data verification)",
@@ -2005,6 +2286,41 @@ static const struct mmc_test_case mmc_test_cases[] = {
 		.cleanup = mmc_test_area_cleanup,
 	},
 
+	{
+		.name = "Consecutive read performance, non-blocking",
+		.prepare = mmc_test_area_prepare_fill,
+		.run = mmc_test_profile_seq_read_nonblock,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Consecutive write performance, non-blocking",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_profile_seq_write_nonblock,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random read performance, non-blocking",
+		.prepare = mmc_test_area_prepare_fill,
+		.run = mmc_test_profile_rnd_read_nonblock,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random write performance, non-blocking",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_profile_rnd_write_nonblock,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random 4KiB write performance, packed",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_profile_packed_write_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
 };
 
 static DEFINE_MUTEX(mmc_test_lock);
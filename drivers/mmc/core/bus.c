@@ -248,6 +248,7 @@ struct mmc_card *mmc_alloc_card(struct mmc_host *host, struct device_type *type)
 		return ERR_PTR(-ENOMEM);
 
 	card->host = host;
+	spin_lock_init(&card->wr_pack_stats.lock);
 
 	device_initialize(&card->dev);
 
@@ -320,6 +321,9 @@ int mmc_add_card(struct mmc_card *card)
 	mmc_add_card_debugfs(card);
 #endif
 
+	if (device_async_suspend_enabled(card->dev.parent))
+		device_enable_async_suspend(&card->dev);
+
 	ret = device_add(&card->dev);
 	if (ret)
 		return ret;
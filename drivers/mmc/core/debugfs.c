@@ -284,6 +284,68 @@ static const struct file_operations mmc_dbg_ext_csd_fops = {
 	.llseek		= default_llseek,
 };
 
+static int mmc_wr_pack_stats_show(struct seq_file *s, void *data)
+{
+	struct mmc_card *card = s->private;
+	struct mmc_wr_pack_stats stats;
+	unsigned long cmds, reqs;
+
+	spin_lock(&card->wr_pack_stats.lock);
+	stats = card->wr_pack_stats;
+	spin_unlock(&card->wr_pack_stats.lock);
+
+	cmds = stats.single + stats.packed + stats.merged;
+	reqs = stats.single + stats.packed_reqs + stats.merged_reqs;
+
+	seq_printf(s, "single writes:\t%lu\n", stats.single);
+	seq_printf(s, "packed writes:\t%lu (%lu requests)\n",
+		   stats.packed, stats.packed_reqs);
+	seq_printf(s, "merged writes:\t%lu (%lu requests)\n",
+		   stats.merged, stats.merged_reqs);
+	seq_printf(s, "unpacked:\t%lu\n", stats.unpacked);
+	seq_printf(s, "max depth:\t%u\n", stats.max_depth);
+	if (cmds)
+		seq_printf(s, "packing ratio:\t%lu.%02lu requests/command\n",
+			   reqs / cmds, (reqs % cmds) * 100 / cmds);
+
+	return 0;
+}
+
+static int mmc_wr_pack_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_wr_pack_stats_show, inode->i_private);
+}
+
+/* Any write clears the counters. */
+static ssize_t mmc_wr_pack_stats_write(struct file *filp,
+				       const char __user *ubuf,
+				       size_t cnt, loff_t *ppos)
+{
+	struct mmc_card *card =
+		((struct seq_file *)filp->private_data)->private;
+	struct mmc_wr_pack_stats *stats = &card->wr_pack_stats;
+
+	spin_lock(&stats->lock);
+	stats->single = 0;
+	stats->packed = 0;
+	stats->packed_reqs = 0;
+	stats->merged = 0;
+	stats->merged_reqs = 0;
+	stats->unpacked = 0;
+	stats->max_depth = 0;
+	spin_unlock(&stats->lock);
+
+	return cnt;
+}
+
+static const struct file_operations mmc_dbg_wr_pack_stats_fops = {
+	.open		= mmc_wr_pack_stats_open,
+	.read		= seq_read,
+	.write		= mmc_wr_pack_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void mmc_add_card_debugfs(struct mmc_card *card)
 {
 	struct mmc_host	*host = card->host;
@@ -316,6 +378,12 @@ void mmc_add_card_debugfs(struct mmc_card *card)
 					&mmc_dbg_ext_csd_fops))
 			goto err;
 
+	if (mmc_card_mmc(card) || mmc_card_sd(card))
+		if (!debugfs_create_file("wr_pack_stats", S_IRUSR | S_IWUSR,
+					root, card,
+					&mmc_dbg_wr_pack_stats_fops))
+			goto err;
+
 	return;
 
 err:
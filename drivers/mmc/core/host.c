@@ -393,6 +393,10 @@ int mmc_add_host(struct mmc_host *host)
 
 	led_trigger_register_simple(dev_name(&host->class_dev), &host->led);
 
+	/* Resume along with the controller if it resumes asynchronously */
+	if (device_async_suspend_enabled(host->parent))
+		device_enable_async_suspend(&host->class_dev);
+
 	err = device_add(&host->class_dev);
 	if (err)
 		return err;
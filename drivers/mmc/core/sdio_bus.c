@@ -310,6 +310,9 @@ int sdio_add_func(struct sdio_func *func)
 
 	dev_set_name(&func->dev, "%s:%d", mmc_card_id(func->card), func->num);
 
+	if (device_async_suspend_enabled(func->dev.parent))
+		device_enable_async_suspend(&func->dev);
+
 	ret = device_add(&func->dev);
 	if (ret == 0)
 		sdio_func_set_present(func);
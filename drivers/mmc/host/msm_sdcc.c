@@ -3637,6 +3637,14 @@ msmsdcc_probe(struct platform_device *pdev)
 	if (plat->is_sdio_al_client)
 		mmc->pm_flags |= MMC_PM_IGNORE_PM_NOTIFY;
 
+	/*
+	 * Re-initializing the SDIO card on resume is slow and no other
+	 * device depends on it, so resume the slot asynchronously. The
+	 * host, card and function devices below it follow.
+	 */
+	if (plat->is_sdio_al_client)
+		device_enable_async_suspend(&pdev->dev);
+
 	mmc->max_segs = NR_SG;
 	mmc->max_blk_size = 4096;	/* MCI_DATA_CTL BLOCKSIZE up to 4096 */
 	mmc->max_blk_count = 65535;
@@ -3791,6 +3799,7 @@ msmsdcc_probe(struct platform_device *pdev)
         {
     		mmc->pm_flags |= MMC_PM_IGNORE_PM_NOTIFY;
         }
+		device_enable_async_suspend(&pdev->dev);
 	}
 #endif
 	mmc_add_host(mmc);
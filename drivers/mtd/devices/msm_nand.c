@@ -24,6 +24,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/io.h>
 #include <linux/crc16.h>
+#include <linux/completion.h>
 #include <linux/bitrev.h>
 
 #include <asm/dma.h>
@@ -1989,6 +1990,530 @@ err_dma_map_oobbuf_failed:
 	return err;
 }
 
+/*
+ * Queued multi-page transfers
+ *
+ * The read_oob/write_oob paths build one command list per page, hand it to
+ * the data mover with msm_dmov_exec_cmd() and sleep until it completes, so
+ * the NAND controller sits idle while the CPU checks the status words and
+ * builds the list for the next page.  For plain multi-page reads and writes we instead
+ * keep MSM_NAND_QUEUE_DEPTH per-page command lists queued on the data mover
+ * channel: while the result of page N is being examined, the list for page
+ * N+1 is already issuing its commands and moving data, and the list for
+ * page N+2 is built into the slot page N just vacated.
+ */
+#define MSM_NAND_QUEUE_DEPTH 2
+
+struct msm_nand_queued_cmd {
+	struct msm_dmov_cmd dmov_cmd;
+	struct completion complete;
+	unsigned int result;
+};
+
+struct msm_nand_read_cmdlist {
+	dmov_s cmd[8 * 4 + 2];
+	unsigned cmdptr;
+	struct {
+		uint32_t cmd;
+		uint32_t addr0;
+		uint32_t addr1;
+		uint32_t chipsel;
+		uint32_t cfg0;
+		uint32_t cfg1;
+		uint32_t eccbchcfg;
+		uint32_t exec;
+		uint32_t ecccfg;
+		struct {
+			uint32_t flash_status;
+			uint32_t buffer_status;
+		} result[8];
+	} data;
+} __aligned(8);
+
+struct msm_nand_write_cmdlist {
+	dmov_s cmd[8 * 6 + 2];
+	unsigned cmdptr;
+	struct {
+		uint32_t cmd;
+		uint32_t addr0;
+		uint32_t addr1;
+		uint32_t chipsel;
+		uint32_t cfg0;
+		uint32_t cfg1;
+		uint32_t eccbchcfg;
+		uint32_t exec;
+		uint32_t ecccfg;
+		uint32_t clrfstatus;
+		uint32_t clrrstatus;
+		uint32_t flash_status[8];
+	} data;
+} __aligned(8);
+
+static void msm_nand_queued_cmd_complete(struct msm_dmov_cmd *cmd,
+					 unsigned int result,
+					 struct msm_dmov_errdata *err)
+{
+	struct msm_nand_queued_cmd *qcmd =
+		container_of(cmd, struct msm_nand_queued_cmd, dmov_cmd);
+
+	qcmd->result = result;
+	complete(&qcmd->complete);
+}
+
+static void msm_nand_queue_cmd(struct msm_nand_chip *chip,
+			       struct msm_nand_queued_cmd *qcmd,
+			       unsigned *cmdptr)
+{
+	qcmd->dmov_cmd.cmdptr = DMOV_CMD_PTR_LIST |
+		DMOV_CMD_ADDR(msm_virt_to_dma(chip, cmdptr));
+	qcmd->dmov_cmd.crci_mask = crci_mask;
+	qcmd->dmov_cmd.complete_func = msm_nand_queued_cmd_complete;
+	qcmd->dmov_cmd.exec_func = NULL;
+	qcmd->result = 0;
+	init_completion(&qcmd->complete);
+
+	mb();
+	msm_dmov_enqueue_cmd(chip->dma_channel, &qcmd->dmov_cmd);
+}
+
+static int msm_nand_wait_queued_cmd(struct msm_nand_queued_cmd *qcmd)
+{
+	wait_for_completion_io(&qcmd->complete);
+	mb();
+
+	/* top pointer done with no error or flush */
+	if (qcmd->result != 0x80000002) {
+		pr_err("%s: data mover error, result %x\n",
+		       __func__, qcmd->result);
+		return -EIO;
+	}
+	return 0;
+}
+
+static void msm_nand_build_read_cmdlist(struct msm_nand_chip *chip,
+					struct msm_nand_read_cmdlist *list,
+					unsigned cwperpage, unsigned page,
+					dma_addr_t data_dma_addr)
+{
+	dmov_s *cmd = list->cmd;
+	uint32_t sectordatasize;
+	unsigned n;
+
+	/* CMD / ADDR0 / ADDR1 / CHIPSEL program values */
+	list->data.cmd = MSM_NAND_CMD_PAGE_READ_ECC;
+	list->data.cfg0 = (chip->CFG0 & ~(7U << 6)) | ((cwperpage - 1) << 6);
+	list->data.cfg1 = chip->CFG1;
+	if (enable_bch_ecc)
+		list->data.eccbchcfg = chip->ecc_bch_cfg;
+	list->data.addr0 = page << 16;
+	list->data.addr1 = (page >> 16) & 0xff;
+	/* chipsel_0 + enable DM interface */
+	list->data.chipsel = 0 | 4;
+	/* GO bit for the EXEC register */
+	list->data.exec = 1;
+	list->data.ecccfg = chip->ecc_buf_cfg;
+
+	for (n = 0; n < cwperpage; n++) {
+		/* flash + buffer status return words */
+		list->data.result[n].flash_status = 0xeeeeeeee;
+		list->data.result[n].buffer_status = 0xeeeeeeee;
+
+		/* block on cmd ready, then
+		 * write CMD / ADDR0 / ADDR1 / CHIPSEL regs in a burst
+		 */
+		cmd->cmd = DST_CRCI_NAND_CMD;
+		cmd->src = msm_virt_to_dma(chip, &list->data.cmd);
+		cmd->dst = MSM_NAND_FLASH_CMD;
+		cmd->len = (n == 0) ? 16 : 4;
+		cmd++;
+
+		if (n == 0) {
+			cmd->cmd = 0;
+			cmd->src = msm_virt_to_dma(chip, &list->data.cfg0);
+			cmd->dst = MSM_NAND_DEV0_CFG0;
+			cmd->len = enable_bch_ecc ? 12 : 8;
+			cmd++;
+
+			cmd->cmd = 0;
+			cmd->src = msm_virt_to_dma(chip, &list->data.ecccfg);
+			cmd->dst = MSM_NAND_EBI2_ECC_BUF_CFG;
+			cmd->len = 4;
+			cmd++;
+		}
+
+		/* kick the execute register */
+		cmd->cmd = 0;
+		cmd->src = msm_virt_to_dma(chip, &list->data.exec);
+		cmd->dst = MSM_NAND_EXEC_CMD;
+		cmd->len = 4;
+		cmd++;
+
+		/* block on data ready, then read the status register */
+		cmd->cmd = SRC_CRCI_NAND_DATA;
+		cmd->src = MSM_NAND_FLASH_STATUS;
+		cmd->dst = msm_virt_to_dma(chip, &list->data.result[n]);
+		/* MSM_NAND_FLASH_STATUS + MSM_NAND_BUFFER_STATUS */
+		cmd->len = 8;
+		cmd++;
+
+		/* read data block (only valid if status says success) */
+		sectordatasize = (n < (cwperpage - 1)) ?
+			516 : (512 - ((cwperpage - 1) << 2));
+		cmd->cmd = 0;
+		cmd->src = MSM_NAND_FLASH_BUFFER;
+		cmd->dst = data_dma_addr;
+		cmd->len = sectordatasize;
+		data_dma_addr += sectordatasize;
+		cmd++;
+	}
+
+	BUILD_BUG_ON(8 * 4 + 2 != ARRAY_SIZE(list->cmd));
+	BUG_ON(cmd - list->cmd > ARRAY_SIZE(list->cmd));
+	list->cmd[0].cmd |= CMD_OCB;
+	cmd[-1].cmd |= CMD_OCU | CMD_LC;
+
+	list->cmdptr = (msm_virt_to_dma(chip, list->cmd) >> 3) | CMD_PTR_LP;
+}
+
+static int msm_nand_check_read_cmdlist(struct mtd_info *mtd,
+				       struct msm_nand_read_cmdlist *list,
+				       uint8_t *datbuf, dma_addr_t data_dma_addr,
+				       uint32_t *total_ecc_errors)
+{
+	struct msm_nand_chip *chip = mtd->priv;
+	unsigned cwperpage = mtd->writesize >> 9;
+	uint32_t ecc_errors;
+	int pageerr = 0, rawerr = 0;
+	unsigned n;
+
+	/* if any of the reads failed (0x10), or there
+	 * was a protection violation (0x100), we lose
+	 */
+	for (n = 0; n < cwperpage; n++) {
+		if (list->data.result[n].flash_status & 0x110) {
+			rawerr = -EIO;
+			break;
+		}
+	}
+	if (rawerr) {
+		dma_sync_single_for_cpu(chip->dev, data_dma_addr,
+					mtd->writesize, DMA_BIDIRECTIONAL);
+		for (n = 0; n < mtd->writesize; n++) {
+			/* empty blocks read 0x54 at these offsets */
+			if ((n % 516 == 3 || n % 516 == 175)
+					&& datbuf[n] == 0x54)
+				datbuf[n] = 0xff;
+			if (datbuf[n] != 0xff) {
+				pageerr = rawerr;
+				break;
+			}
+		}
+		dma_sync_single_for_device(chip->dev, data_dma_addr,
+					   mtd->writesize, DMA_BIDIRECTIONAL);
+	}
+	if (pageerr) {
+		for (n = 0; n < cwperpage; n++) {
+			if (enable_bch_ecc ?
+			    (list->data.result[n].buffer_status & 0x10) :
+			    (list->data.result[n].buffer_status & 0x8)) {
+				/* not thread safe */
+				mtd->ecc_stats.failed++;
+				pageerr = -EBADMSG;
+				break;
+			}
+		}
+	}
+	if (!rawerr) { /* check for correctable errors */
+		for (n = 0; n < cwperpage; n++) {
+			ecc_errors = enable_bch_ecc ?
+				(list->data.result[n].buffer_status & 0xF) :
+				(list->data.result[n].buffer_status & 0x7);
+			if (ecc_errors) {
+				*total_ecc_errors += ecc_errors;
+				/* not thread safe */
+				mtd->ecc_stats.corrected += ecc_errors;
+				if (ecc_errors > 1)
+					pageerr = -EUCLEAN;
+			}
+		}
+	}
+	return pageerr;
+}
+
+static int msm_nand_read_pages_queued(struct mtd_info *mtd, loff_t from,
+				      struct mtd_oob_ops *ops)
+{
+	struct msm_nand_chip *chip = mtd->priv;
+	struct {
+		struct msm_nand_read_cmdlist list[MSM_NAND_QUEUE_DEPTH];
+	} *dma_buffer;
+	struct msm_nand_queued_cmd qcmd[MSM_NAND_QUEUE_DEPTH];
+	unsigned cwperpage = mtd->writesize >> 9;
+	unsigned page = from >> (ffs(mtd->writesize) - 1);
+	unsigned page_count = ops->len / mtd->writesize;
+	unsigned pages_issued = 0;
+	unsigned pages_done = 0;
+	unsigned pages_read = 0;
+	unsigned slot;
+	uint32_t total_ecc_errors = 0;
+	dma_addr_t data_dma_addr;
+	int err = 0, pageerr, stop = 0;
+
+	data_dma_addr = msm_nand_dma_map(chip->dev, ops->datbuf, ops->len,
+					 DMA_BIDIRECTIONAL);
+	if (dma_mapping_error(chip->dev, data_dma_addr)) {
+		pr_err("%s: failed to get dma addr for %p\n",
+		       __func__, ops->datbuf);
+		return -EIO;
+	}
+
+	wait_event(chip->wait_queue,
+		   (dma_buffer = msm_nand_get_dma_buffer(
+			    chip, sizeof(*dma_buffer))));
+
+	/* prime the pipeline */
+	while (pages_issued < page_count &&
+	       pages_issued < MSM_NAND_QUEUE_DEPTH) {
+		slot = pages_issued;
+		msm_nand_build_read_cmdlist(chip, &dma_buffer->list[slot],
+			cwperpage, page + pages_issued,
+			data_dma_addr + pages_issued * mtd->writesize);
+		msm_nand_queue_cmd(chip, &qcmd[slot],
+				   &dma_buffer->list[slot].cmdptr);
+		pages_issued++;
+	}
+
+	while (pages_done < pages_issued) {
+		slot = pages_done % MSM_NAND_QUEUE_DEPTH;
+
+		pageerr = msm_nand_wait_queued_cmd(&qcmd[slot]);
+		if (!pageerr && !stop)
+			pageerr = msm_nand_check_read_cmdlist(mtd,
+				&dma_buffer->list[slot],
+				ops->datbuf + pages_done * mtd->writesize,
+				data_dma_addr + pages_done * mtd->writesize,
+				&total_ecc_errors);
+		pages_done++;
+		/* after a hard error we only drain what is still queued */
+		if (stop)
+			continue;
+
+		if (pageerr && (pageerr != -EUCLEAN || err == 0))
+			err = pageerr;
+		if (err && err != -EUCLEAN && err != -EBADMSG) {
+			stop = 1;
+			continue;
+		}
+		pages_read++;
+
+		if (pages_issued < page_count) {
+			msm_nand_build_read_cmdlist(chip,
+				&dma_buffer->list[slot], cwperpage,
+				page + pages_issued,
+				data_dma_addr + pages_issued * mtd->writesize);
+			msm_nand_queue_cmd(chip, &qcmd[slot],
+					   &dma_buffer->list[slot].cmdptr);
+			pages_issued++;
+		}
+	}
+
+	msm_nand_release_dma_buffer(chip, dma_buffer, sizeof(*dma_buffer));
+	dma_unmap_page(chip->dev, data_dma_addr, ops->len, DMA_BIDIRECTIONAL);
+
+	ops->retlen = mtd->writesize * pages_read;
+	ops->oobretlen = 0;
+	if (err)
+		pr_err("%s %llx %x failed %d, corrected %d\n", __func__,
+		       from, ops->len, err, total_ecc_errors);
+	return err;
+}
+
+static void msm_nand_build_write_cmdlist(struct msm_nand_chip *chip,
+					 struct msm_nand_write_cmdlist *list,
+					 unsigned cwperpage, unsigned page,
+					 dma_addr_t data_dma_addr)
+{
+	dmov_s *cmd = list->cmd;
+	uint32_t sectordatawritesize;
+	unsigned n;
+
+	list->data.cfg0 = chip->CFG0;
+	list->data.cfg1 = chip->CFG1;
+	if (enable_bch_ecc)
+		list->data.eccbchcfg = chip->ecc_bch_cfg;
+
+	/* CMD / ADDR0 / ADDR1 / CHIPSEL program values */
+	list->data.cmd = MSM_NAND_CMD_PRG_PAGE;
+	list->data.addr0 = page << 16;
+	list->data.addr1 = (page >> 16) & 0xff;
+	/* chipsel_0 + enable DM interface */
+	list->data.chipsel = 0 | 4;
+	/* GO bit for the EXEC register */
+	list->data.exec = 1;
+	list->data.ecccfg = chip->ecc_buf_cfg;
+	list->data.clrfstatus = 0x00000020;
+	list->data.clrrstatus = 0x000000C0;
+
+	for (n = 0; n < cwperpage; n++) {
+		/* status return words */
+		list->data.flash_status[n] = 0xeeeeeeee;
+
+		/* block on cmd ready, then
+		 * write CMD / ADDR0 / ADDR1 / CHIPSEL regs in a burst
+		 */
+		cmd->cmd = DST_CRCI_NAND_CMD;
+		cmd->src = msm_virt_to_dma(chip, &list->data.cmd);
+		cmd->dst = MSM_NAND_FLASH_CMD;
+		cmd->len = (n == 0) ? 16 : 4;
+		cmd++;
+
+		if (n == 0) {
+			cmd->cmd = 0;
+			cmd->src = msm_virt_to_dma(chip, &list->data.cfg0);
+			cmd->dst = MSM_NAND_DEV0_CFG0;
+			cmd->len = enable_bch_ecc ? 12 : 8;
+			cmd++;
+
+			cmd->cmd = 0;
+			cmd->src = msm_virt_to_dma(chip, &list->data.ecccfg);
+			cmd->dst = MSM_NAND_EBI2_ECC_BUF_CFG;
+			cmd->len = 4;
+			cmd++;
+		}
+
+		/* write data block */
+		sectordatawritesize = (n < (cwperpage - 1)) ?
+			516 : (512 - ((cwperpage - 1) << 2));
+		cmd->cmd = 0;
+		cmd->src = data_dma_addr;
+		cmd->dst = MSM_NAND_FLASH_BUFFER;
+		cmd->len = sectordatawritesize;
+		data_dma_addr += sectordatawritesize;
+		cmd++;
+
+		/* kick the execute register */
+		cmd->cmd = 0;
+		cmd->src = msm_virt_to_dma(chip, &list->data.exec);
+		cmd->dst = MSM_NAND_EXEC_CMD;
+		cmd->len = 4;
+		cmd++;
+
+		/* block on data ready, then read the status register */
+		cmd->cmd = SRC_CRCI_NAND_DATA;
+		cmd->src = MSM_NAND_FLASH_STATUS;
+		cmd->dst = msm_virt_to_dma(chip, &list->data.flash_status[n]);
+		cmd->len = 4;
+		cmd++;
+
+		cmd->cmd = 0;
+		cmd->src = msm_virt_to_dma(chip, &list->data.clrfstatus);
+		cmd->dst = MSM_NAND_FLASH_STATUS;
+		cmd->len = 4;
+		cmd++;
+
+		cmd->cmd = 0;
+		cmd->src = msm_virt_to_dma(chip, &list->data.clrrstatus);
+		cmd->dst = MSM_NAND_READ_STATUS;
+		cmd->len = 4;
+		cmd++;
+	}
+
+	BUILD_BUG_ON(8 * 6 + 2 != ARRAY_SIZE(list->cmd));
+	BUG_ON(cmd - list->cmd > ARRAY_SIZE(list->cmd));
+	list->cmd[0].cmd |= CMD_OCB;
+	cmd[-1].cmd |= CMD_OCU | CMD_LC;
+
+	list->cmdptr = (msm_virt_to_dma(chip, list->cmd) >> 3) | CMD_PTR_LP;
+}
+
+static int msm_nand_write_pages_queued(struct mtd_info *mtd, loff_t to,
+				       struct mtd_oob_ops *ops)
+{
+	struct msm_nand_chip *chip = mtd->priv;
+	struct {
+		struct msm_nand_write_cmdlist list[MSM_NAND_QUEUE_DEPTH];
+	} *dma_buffer;
+	struct msm_nand_queued_cmd qcmd[MSM_NAND_QUEUE_DEPTH];
+	struct msm_nand_write_cmdlist *list;
+	unsigned cwperpage = mtd->writesize >> 9;
+	unsigned page = to >> (ffs(mtd->writesize) - 1);
+	unsigned page_count = ops->len / mtd->writesize;
+	unsigned pages_issued = 0;
+	unsigned pages_done = 0;
+	unsigned pages_written = 0;
+	unsigned slot, n;
+	dma_addr_t data_dma_addr;
+	int err = 0;
+
+	data_dma_addr = msm_nand_dma_map(chip->dev, ops->datbuf, ops->len,
+					 DMA_TO_DEVICE);
+	if (dma_mapping_error(chip->dev, data_dma_addr)) {
+		pr_err("%s: failed to get dma addr for %p\n",
+		       __func__, ops->datbuf);
+		return -EIO;
+	}
+
+	wait_event(chip->wait_queue,
+		   (dma_buffer = msm_nand_get_dma_buffer(
+			    chip, sizeof(*dma_buffer))));
+
+	/* prime the pipeline */
+	while (pages_issued < page_count &&
+	       pages_issued < MSM_NAND_QUEUE_DEPTH) {
+		slot = pages_issued;
+		msm_nand_build_write_cmdlist(chip, &dma_buffer->list[slot],
+			cwperpage, page + pages_issued,
+			data_dma_addr + pages_issued * mtd->writesize);
+		msm_nand_queue_cmd(chip, &qcmd[slot],
+				   &dma_buffer->list[slot].cmdptr);
+		pages_issued++;
+	}
+
+	while (pages_done < pages_issued) {
+		slot = pages_done % MSM_NAND_QUEUE_DEPTH;
+		list = &dma_buffer->list[slot];
+
+		if (msm_nand_wait_queued_cmd(&qcmd[slot]) && !err)
+			err = -EIO;
+		pages_done++;
+		/* after a failure we only drain what is still queued */
+		if (err)
+			continue;
+
+		/* if any of the writes failed (0x10), or there was a
+		 * protection violation (0x100), or the program success
+		 * bit (0x80) is unset, we lose
+		 */
+		for (n = 0; n < cwperpage; n++) {
+			if ((list->data.flash_status[n] & 0x110) ||
+			    !(list->data.flash_status[n] & 0x80)) {
+				err = -EIO;
+				break;
+			}
+		}
+		if (err)
+			continue;
+		pages_written++;
+
+		if (pages_issued < page_count) {
+			msm_nand_build_write_cmdlist(chip, list, cwperpage,
+				page + pages_issued,
+				data_dma_addr + pages_issued * mtd->writesize);
+			msm_nand_queue_cmd(chip, &qcmd[slot], &list->cmdptr);
+			pages_issued++;
+		}
+	}
+
+	msm_nand_release_dma_buffer(chip, dma_buffer, sizeof(*dma_buffer));
+	dma_unmap_page(chip->dev, data_dma_addr, ops->len, DMA_TO_DEVICE);
+
+	ops->retlen = mtd->writesize * pages_written;
+	ops->oobretlen = 0;
+	if (err)
+		pr_err("%s %llx %x failed %d\n", __func__, to, ops->len, err);
+	return err;
+}
+
 static int
 msm_nand_read(struct mtd_info *mtd, loff_t from, size_t len,
 	      size_t *retlen, u_char *buf)
@@ -2004,7 +2529,10 @@ msm_nand_read(struct mtd_info *mtd, loff_t from, size_t len,
 	ops.ooblen = 0;
 	ops.datbuf = buf;
 	ops.oobbuf = NULL;
-	if (!dual_nand_ctlr_present)
+	if (!dual_nand_ctlr_present && len > mtd->writesize &&
+	    !(from & (mtd->writesize - 1)) && !(len % mtd->writesize))
+		ret = msm_nand_read_pages_queued(mtd, from, &ops);
+	else if (!dual_nand_ctlr_present)
 		ret =  msm_nand_read_oob(mtd, from, &ops);
 	else
 		ret = msm_nand_read_oob_dualnandc(mtd, from, &ops);
@@ -2975,7 +3503,10 @@ static int msm_nand_write(struct mtd_info *mtd, loff_t to, size_t len,
 	ops.ooblen = 0;
 	ops.datbuf = (uint8_t *)buf;
 	ops.oobbuf = NULL;
-	if (!dual_nand_ctlr_present)
+	if (!dual_nand_ctlr_present && len > mtd->writesize &&
+	    !(to & (mtd->writesize - 1)) && !(len % mtd->writesize))
+		ret = msm_nand_write_pages_queued(mtd, to, &ops);
+	else if (!dual_nand_ctlr_present)
 		ret =  msm_nand_write_oob(mtd, to, &ops);
 	else
 		ret =  msm_nand_write_oob_dualnandc(mtd, to, &ops);
@@ -104,6 +104,8 @@ int rmnet_get_max_mtu(void)
 
 #define HEADROOM_FOR_QOS    8
 
+#define RMNET_NAPI_WEIGHT   64
+
 static struct completion *port_complete[RMNET_DEVICE_COUNT];
 
 struct rmnet_private
@@ -121,6 +123,7 @@ struct rmnet_private
 	struct sk_buff *skb;
 	spinlock_t lock;
 	struct tasklet_struct tsklt;
+	struct napi_struct napi;
 	u32 operation_mode;    /* IOCTL specified mode (protocol, QoS header) */
 	struct platform_driver pdrv;
 	struct completion complete;
@@ -266,6 +269,8 @@ static __be16 rmnet_ip_type_trans(struct sk_buff *skb, struct net_device *dev)
 	__be16 protocol = 0;
 
 	skb->dev = dev;
+	/* No link header, lets GRO and taps see the IP header */
+	skb_reset_mac_header(skb);
 
 	/* Determine L3 protocol */
 	switch (skb->data[0] & 0xf0) {
@@ -283,21 +288,33 @@ static __be16 rmnet_ip_type_trans(struct sk_buff *skb, struct net_device *dev)
 	return protocol;
 }
 
-/* Called in soft-irq context */
-static void smd_net_data_handler(unsigned long arg)
+static int smd_net_rx_pending(struct rmnet_private *p)
+{
+	int sz;
+
+	if (!p->ch)
+		return 0;
+	sz = smd_cur_packet_size(p->ch);
+	return sz && smd_read_avail(p->ch) >= sz;
+}
+
+/* NAPI poll, called in soft-irq context */
+static int rmnet_poll(struct napi_struct *napi, int budget)
 {
-	struct net_device *dev = (struct net_device *) arg;
+	struct net_device *dev = napi->dev;
 	struct rmnet_private *p = netdev_priv(dev);
 	struct sk_buff *skb;
 	void *ptr = 0;
 	int sz;
 	u32 opmode = p->operation_mode;
 	unsigned long flags;
+	int work = 0;
 
-	for (;;) {
+	while (work < budget) {
 		sz = smd_cur_packet_size(p->ch);
 		if (sz == 0) break;
 		if (smd_read_avail(p->ch) < sz) break;
+		work++;
 
 		if (RMNET_IS_MODE_IP(opmode) ? (sz > dev->mtu) :
 						(sz > (dev->mtu + ETH_HLEN))) {
@@ -349,7 +366,7 @@ static void smd_net_data_handler(unsigned long arg)
 						skb->len);
 
 					/* Deliver to network stack */
-					netif_rx(skb);
+					napi_gro_receive(napi, skb);
 				}
 				continue;
 			}
@@ -358,9 +375,15 @@ static void smd_net_data_handler(unsigned long arg)
 			pr_err("[%s] rmnet_recv() smd lied about avail?!",
 				dev->name);
 	}
-}
 
-static DECLARE_TASKLET(smd_net_data_tasklet, smd_net_data_handler, 0);
+	if (work < budget) {
+		napi_complete(napi);
+		/* Data that came in before napi_complete() raised no poll */
+		if (smd_net_rx_pending(p))
+			napi_schedule(napi);
+	}
+	return work;
+}
 
 static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 {
@@ -478,10 +501,8 @@ static void smd_net_notify(void *_dev, unsigned event)
 		spin_unlock(&p->lock);
 
 		if (smd_read_avail(p->ch) &&
-			(smd_read_avail(p->ch) >= smd_cur_packet_size(p->ch))) {
-			smd_net_data_tasklet.data = (unsigned long) _dev;
-			tasklet_schedule(&smd_net_data_tasklet);
-		}
+			(smd_read_avail(p->ch) >= smd_cur_packet_size(p->ch)))
+			napi_schedule(&p->napi);
 		break;
 
 	case SMD_EVENT_OPEN:
@@ -546,13 +567,21 @@ static int __rmnet_close(struct net_device *dev)
 
 static int rmnet_open(struct net_device *dev)
 {
+	struct rmnet_private *p = netdev_priv(dev);
 	int rc = 0;
 
 	DBG0("[%s] rmnet_open()\n", dev->name);
 
 	rc = __rmnet_open(dev);
-	if (rc == 0)
+	if (rc == 0) {
+		napi_enable(&p->napi);
 		netif_start_queue(dev);
+		/* Pick up what arrived while the interface was down */
+		local_bh_disable();
+		if (smd_net_rx_pending(p))
+			napi_schedule(&p->napi);
+		local_bh_enable();
+	}
 
 	return rc;
 }
@@ -564,6 +593,7 @@ static int rmnet_stop(struct net_device *dev)
 	DBG0("[%s] rmnet_stop()\n", dev->name);
 
 	netif_stop_queue(dev);
+	napi_disable(&p->napi);
 	tasklet_kill(&p->tsklt);
 
 	/* TODO: unload modem safely,
@@ -775,6 +805,7 @@ static void __init rmnet_setup(struct net_device *dev)
 	/* set this after calling ether_setup */
 	dev->mtu = RMNET_DATA_LEN;
 	dev->needed_headroom = HEADROOM_FOR_QOS;
+	dev->features |= NETIF_F_GRO;
 
 	random_ether_addr(dev->dev_addr);
 
@@ -827,6 +858,7 @@ static int __init rmnet_init(void)
 		spin_lock_init(&p->lock);
 		tasklet_init(&p->tsklt, _rmnet_resume_flow,
 				(unsigned long)dev);
+		netif_napi_add(dev, &p->napi, rmnet_poll, RMNET_NAPI_WEIGHT);
 		wake_lock_init(&p->wake_lock, WAKE_LOCK_SUSPEND, ch_name[n]);
 #ifdef CONFIG_MSM_RMNET_DEBUG
 		p->timeout_us = timeout_us;
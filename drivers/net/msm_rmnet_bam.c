@@ -67,6 +67,7 @@ module_param_named(debug_enable, msm_rmnet_bam_debug_mask,
 
 #define HEADROOM_FOR_BAM   8 /* for mux header */
 #define HEADROOM_FOR_QOS    8
+#define RMNET_NAPI_WEIGHT   64
 #define TAILROOM            8 /* for padding by mux layer */
 
 struct rmnet_private {
@@ -81,6 +82,8 @@ struct rmnet_private {
 	struct sk_buff *skb;
 	spinlock_t lock;
 	struct tasklet_struct tsklt;
+	struct napi_struct napi;
+	struct sk_buff_head rx_queue;	/* handed over to rmnet_poll() */
 	u32 operation_mode; /* IOCTL specified mode (protocol, QoS header) */
 	uint8_t device_up;
 };
@@ -216,6 +219,8 @@ static __be16 rmnet_ip_type_trans(struct sk_buff *skb, struct net_device *dev)
 	__be16 protocol = 0;
 
 	skb->dev = dev;
+	/* No link header, lets GRO and taps see the IP header */
+	skb_reset_mac_header(skb);
 
 	/* Determine L3 protocol */
 	switch (skb->data[0] & 0xf0) {
@@ -243,6 +248,27 @@ static int count_this_packet(void *_hdr, int len)
 	return 1;
 }
 
+/* NAPI poll, passes the frames queued by bam_recv_notify() through GRO */
+static int rmnet_poll(struct napi_struct *napi, int budget)
+{
+	struct rmnet_private *p = netdev_priv(napi->dev);
+	struct sk_buff *skb;
+	int work = 0;
+
+	while (work < budget && (skb = skb_dequeue(&p->rx_queue))) {
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* Frames queued before napi_complete() raised no poll */
+		if (!skb_queue_empty(&p->rx_queue))
+			napi_schedule(napi);
+	}
+	return work;
+}
+
 /* Rx Callback, Called in Work Queue context */
 static void bam_recv_notify(void *dev, struct sk_buff *skb)
 {
@@ -276,8 +302,16 @@ static void bam_recv_notify(void *dev, struct sk_buff *skb)
 			((struct net_device *)dev)->name,
 			p->stats.rx_packets, skb->len);
 
-		/* Deliver to network stack */
-		netif_rx(skb);
+		/* Deliver to network stack from rmnet_poll() */
+		if (skb_queue_len(&p->rx_queue) >= netdev_max_backlog) {
+			p->stats.rx_dropped++;
+			dev_kfree_skb_any(skb);
+			return;
+		}
+		skb_queue_tail(&p->rx_queue, skb);
+		local_bh_disable();
+		napi_schedule(&p->napi);
+		local_bh_enable();
 	} else
 		pr_err("[%s] %s: No skb received",
 			((struct net_device *)dev)->name, __func__);
@@ -582,6 +616,7 @@ static void __init rmnet_setup(struct net_device *dev)
 	dev->mtu = RMNET_DATA_LEN;
 	dev->needed_headroom = HEADROOM_FOR_BAM + HEADROOM_FOR_QOS ;
 	dev->needed_tailroom = TAILROOM;
+	dev->features |= NETIF_F_GRO;
 	random_ether_addr(dev->dev_addr);
 
 	dev->watchdog_timeo = 1000; /* 10 seconds? */
@@ -618,6 +653,13 @@ static int __init rmnet_init(void)
 		p->operation_mode = RMNET_MODE_LLP_ETH;
 		p->ch_id = n;
 		spin_lock_init(&p->lock);
+		skb_queue_head_init(&p->rx_queue);
+		/*
+		 * Frames are delivered whether or not the interface is up,
+		 * as they were with netif_rx(), so the poll stays enabled.
+		 */
+		netif_napi_add(dev, &p->napi, rmnet_poll, RMNET_NAPI_WEIGHT);
+		napi_enable(&p->napi);
 #ifdef CONFIG_MSM_RMNET_DEBUG
 		p->timeout_us = timeout_us;
 		p->wakeups_xmit = p->wakeups_rcv = 0;
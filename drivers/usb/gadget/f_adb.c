@@ -32,13 +32,23 @@
 
 #include <linux/usb/android_composite.h>
 
-#define BULK_BUFFER_SIZE           4096
+#define BULK_BUFFER_SIZE           16384
 
-/* number of tx requests to allocate */
-#define TX_REQ_MAX 4
+/* upper bound for the number of tx requests */
+#define TX_REQ_MAX 32
 
 static const char shortname[] = "android_adb";
 
+/* Number of tx requests and the request size, applied at bind time.
+ * The size is rounded down to whole 512 byte packets; controllers may
+ * limit it (msm72k_udc takes at most 16K per request).
+ */
+static unsigned int adb_tx_reqs = 8;
+module_param(adb_tx_reqs, uint, S_IRUGO | S_IWUSR);
+
+static unsigned int adb_req_len = BULK_BUFFER_SIZE;
+module_param(adb_req_len, uint, S_IRUGO | S_IWUSR);
+
 struct adb_dev {
 	struct usb_function function;
 	struct usb_composite_dev *cdev;
@@ -58,8 +68,16 @@ struct adb_dev {
 
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
-	struct usb_request *rx_req;
-	int rx_done;
+
+	/* The OUT request is queued for the length of the pending read:
+	 * the host sends no ZLP after adb transfers, so a longer request
+	 * would wait forever on one that ends with a full packet.  Once
+	 * completed it waits on rx_done until userspace has copied it.
+	 */
+	struct list_head rx_idle;
+	struct list_head rx_done;
+	unsigned int rx_offset;		/* consumed from the rx_done head */
+	unsigned int req_len;
 };
 
 static struct usb_interface_descriptor adb_interface_desc = {
@@ -211,9 +229,15 @@ static void adb_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct adb_dev *dev = _adb_dev;
 
-	dev->rx_done = 1;
-	if (req->status != 0)
+	if (req->status != 0) {
 		atomic_set(&dev->error, 1);
+		req_put(dev, &dev->rx_idle, req);
+	} else if (req->actual == 0) {
+		/* 0-len packet, queued again by the next adb_read() */
+		req_put(dev, &dev->rx_idle, req);
+	} else {
+		req_put(dev, &dev->rx_done, req);
+	}
 
 	wake_up(&dev->read_wq);
 }
@@ -248,14 +272,16 @@ static int __init create_bulk_endpoints(struct adb_dev *dev,
 	dev->ep_out = ep;
 
 	/* now allocate requests for our endpoints */
-	req = adb_request_new(dev->ep_out, BULK_BUFFER_SIZE);
+	dev->req_len = max(adb_req_len & ~511U, 512U);
+
+	req = adb_request_new(dev->ep_out, dev->req_len);
 	if (!req)
 		goto fail;
 	req->complete = adb_complete_out;
-	dev->rx_req = req;
+	req_put(dev, &dev->rx_idle, req);
 
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = adb_request_new(dev->ep_in, BULK_BUFFER_SIZE);
+	for (i = 0; i < clamp(adb_tx_reqs, 1U, (unsigned int)TX_REQ_MAX); i++) {
+		req = adb_request_new(dev->ep_in, dev->req_len);
 		if (!req)
 			goto fail;
 		req->complete = adb_complete_in;
@@ -269,19 +295,61 @@ fail:
 	return -1;
 }
 
-static ssize_t adb_read(struct file *fp, char __user *buf,
-				size_t count, loff_t *pos)
+/* queue the idle OUT request for a read of len bytes */
+static int adb_rx_fill(struct adb_dev *dev, size_t len)
 {
-	struct adb_dev *dev = fp->private_data;
-	struct usb_composite_dev *cdev = dev->cdev;
 	struct usb_request *req;
-	int r = count, xfer;
 	int ret;
 
-	DBG(cdev, "adb_read(%d)\n", count);
+	req = req_get(dev, &dev->rx_idle);
+	if (!req)
+		return 0;
 
-	if (count > BULK_BUFFER_SIZE)
-		return -EINVAL;
+	req->length = min_t(size_t, len, dev->req_len);
+	ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
+	if (ret < 0) {
+		DBG(dev->cdev, "adb_read: failed to queue req %p (%d)\n",
+			req, ret);
+		req_put(dev, &dev->rx_idle, req);
+		return ret;
+	}
+	DBG(dev->cdev, "rx %p queue\n", req);
+	return 0;
+}
+
+/* forget data received for an earlier reader */
+static void adb_rx_flush(struct adb_dev *dev)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	list_splice_tail_init(&dev->rx_done, &dev->rx_idle);
+	dev->rx_offset = 0;
+	spin_unlock_irqrestore(&dev->lock, flags);
+}
+
+/*
+ * Copy received data to the user buffers.  Blocks until a transfer
+ * sized to the buffers has completed, unless data is left over from
+ * a shorter earlier read.
+ */
+static ssize_t adb_recv(struct adb_dev *dev, const struct iovec *iov,
+		unsigned long nr_segs)
+{
+	struct usb_composite_dev *cdev = dev->cdev;
+	struct usb_request *req;
+	unsigned long seg = 0;
+	size_t seg_off = 0;
+	size_t len = 0;
+	ssize_t r = 0;
+	int xfer;
+	int ret;
+
+	for (seg = 0; seg < nr_segs; seg++)
+		len += iov[seg].iov_len;
+	seg = 0;
+	if (!len)
+		return 0;
 
 	if (_lock(&dev->read_excl))
 		return -EBUSY;
@@ -302,114 +370,182 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 		goto done;
 	}
 
-requeue_req:
-	/* queue a request */
-	req = dev->rx_req;
-	req->length = count;
-	dev->rx_done = 0;
-	ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
-	if (ret < 0) {
-		DBG(cdev, "adb_read: failed to queue req %p (%d)\n", req, ret);
-		r = -EIO;
-		atomic_set(&dev->error, 1);
-		goto done;
-	} else {
-		DBG(cdev, "rx %p queue\n", req);
+	/* wait for the request to complete; a 0-len packet returns it
+	 * to rx_idle and it is queued again
+	 */
+	while (list_empty(&dev->rx_done)) {
+		if (adb_rx_fill(dev, len) < 0) {
+			atomic_set(&dev->error, 1);
+			r = -EIO;
+			goto done;
+		}
+		ret = wait_event_interruptible(dev->read_wq,
+			!list_empty(&dev->rx_done) ||
+			!list_empty(&dev->rx_idle) ||
+			atomic_read(&dev->error));
+		if (ret < 0) {
+			r = ret;
+			goto done;
+		}
+		if (atomic_read(&dev->error)) {
+			r = -EIO;
+			goto done;
+		}
 	}
 
-	/* wait for a request to complete */
-	ret = wait_event_interruptible(dev->read_wq, dev->rx_done);
-	if (ret < 0) {
-		atomic_set(&dev->error, 1);
-		r = ret;
-		usb_ep_dequeue(dev->ep_out, req);
-		goto done;
-	}
-	if (!atomic_read(&dev->error)) {
-		/* If we got a 0-len packet, throw it back and try again. */
-		if (req->actual == 0)
-			goto requeue_req;
+	while (seg < nr_segs) {
+		spin_lock_irq(&dev->lock);
+		req = list_empty(&dev->rx_done) ? NULL :
+			list_first_entry(&dev->rx_done,
+					struct usb_request, list);
+		spin_unlock_irq(&dev->lock);
+		if (!req)
+			break;
 
 		DBG(cdev, "rx %p %d\n", req, req->actual);
-		xfer = (req->actual < count) ? req->actual : count;
-		if (copy_to_user(buf, req->buf, xfer))
+		xfer = min_t(size_t, req->actual - dev->rx_offset,
+				iov[seg].iov_len - seg_off);
+		if (copy_to_user(iov[seg].iov_base + seg_off,
+				req->buf + dev->rx_offset, xfer)) {
 			r = -EFAULT;
-	} else
-		r = -EIO;
+			goto done;
+		}
+		r += xfer;
+		dev->rx_offset += xfer;
+		seg_off += xfer;
+
+		if (dev->rx_offset == req->actual) {
+			spin_lock_irq(&dev->lock);
+			list_move_tail(&req->list, &dev->rx_idle);
+			dev->rx_offset = 0;
+			spin_unlock_irq(&dev->lock);
+		}
+		if (seg_off == iov[seg].iov_len) {
+			seg++;
+			seg_off = 0;
+		}
+	}
 
 done:
 	_unlock(&dev->read_excl);
-	DBG(cdev, "adb_read returning %d\n", r);
+	DBG(cdev, "adb_read returning %zd\n", r);
 	return r;
 }
 
-static ssize_t adb_write(struct file *fp, const char __user *buf,
-				 size_t count, loff_t *pos)
+/*
+ * Send each user buffer as its own transfer(s), split at req_len;
+ * buffers are never merged, as the host reads adb message headers and
+ * payloads with separate transfers.
+ */
+static ssize_t adb_send(struct adb_dev *dev, const struct iovec *iov,
+		unsigned long nr_segs)
 {
-	struct adb_dev *dev = fp->private_data;
 	struct usb_composite_dev *cdev = dev->cdev;
 	struct usb_request *req = 0;
-	int r = count, xfer;
+	const char __user *buf;
+	size_t count;
+	ssize_t r = 0;
+	int xfer;
 	int ret;
 
-	DBG(cdev, "adb_write(%d)\n", count);
-
 	if (_lock(&dev->write_excl))
 		return -EBUSY;
 
-	while (count > 0) {
-		if (atomic_read(&dev->error)) {
-			DBG(cdev, "adb_write dev->error\n");
-			r = -EIO;
-			break;
-		}
+	for (; nr_segs > 0; nr_segs--, iov++) {
+		buf = iov->iov_base;
+		count = iov->iov_len;
 
-		/* get an idle tx request to use */
-		req = 0;
-		ret = wait_event_interruptible(dev->write_wq,
-			((req = req_get(dev, &dev->tx_idle)) ||
-			 atomic_read(&dev->error)));
-
-		if (ret < 0) {
-			r = ret;
-			break;
-		}
-
-		if (req != 0) {
-			if (count > BULK_BUFFER_SIZE)
-				xfer = BULK_BUFFER_SIZE;
-			else
-				xfer = count;
-			if (copy_from_user(req->buf, buf, xfer)) {
-				r = -EFAULT;
-				break;
+		while (count > 0) {
+			if (atomic_read(&dev->error)) {
+				DBG(cdev, "adb_write dev->error\n");
+				r = -EIO;
+				goto out;
 			}
 
-			req->length = xfer;
-			ret = usb_ep_queue(dev->ep_in, req, GFP_ATOMIC);
+			/* get an idle tx request to use */
+			req = 0;
+			ret = wait_event_interruptible(dev->write_wq,
+				((req = req_get(dev, &dev->tx_idle)) ||
+				 atomic_read(&dev->error)));
+
 			if (ret < 0) {
-				DBG(cdev, "adb_write: xfer error %d\n", ret);
-				atomic_set(&dev->error, 1);
-				r = -EIO;
-				break;
+				r = ret;
+				goto out;
 			}
 
-			buf += xfer;
-			count -= xfer;
-
-			/* zero this so we don't try to free it on error exit */
-			req = 0;
+			if (req != 0) {
+				if (count > dev->req_len)
+					xfer = dev->req_len;
+				else
+					xfer = count;
+				if (copy_from_user(req->buf, buf, xfer)) {
+					r = -EFAULT;
+					goto out;
+				}
+
+				req->length = xfer;
+				ret = usb_ep_queue(dev->ep_in, req, GFP_ATOMIC);
+				if (ret < 0) {
+					DBG(cdev, "adb_write: xfer error %d\n",
+						ret);
+					atomic_set(&dev->error, 1);
+					r = -EIO;
+					goto out;
+				}
+
+				buf += xfer;
+				count -= xfer;
+				r += xfer;
+
+				/* zero this so we don't try to free it on
+				 * error exit
+				 */
+				req = 0;
+			}
 		}
 	}
 
+out:
 	if (req)
 		req_put(dev, &dev->tx_idle, req);
 
 	_unlock(&dev->write_excl);
-	DBG(cdev, "adb_write returning %d\n", r);
+	DBG(cdev, "adb_write returning %zd\n", r);
 	return r;
 }
 
+static ssize_t adb_read(struct file *fp, char __user *buf,
+				size_t count, loff_t *pos)
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = count };
+
+	DBG(_adb_dev->cdev, "adb_read(%d)\n", count);
+	return adb_recv(fp->private_data, &iov, 1);
+}
+
+static ssize_t adb_write(struct file *fp, const char __user *buf,
+				 size_t count, loff_t *pos)
+{
+	struct iovec iov = { .iov_base = (void __user *)buf,
+			     .iov_len = count };
+
+	DBG(_adb_dev->cdev, "adb_write(%d)\n", count);
+	return adb_send(fp->private_data, &iov, 1);
+}
+
+/* readv() and writev() */
+static ssize_t adb_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				unsigned long nr_segs, loff_t pos)
+{
+	return adb_recv(iocb->ki_filp->private_data, iov, nr_segs);
+}
+
+static ssize_t adb_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				unsigned long nr_segs, loff_t pos)
+{
+	return adb_send(iocb->ki_filp->private_data, iov, nr_segs);
+}
+
 static int adb_open(struct inode *ip, struct file *fp)
 {
 	pr_debug("adb_open\n");
@@ -420,6 +556,7 @@ static int adb_open(struct inode *ip, struct file *fp)
 
 	/* clear the error latch */
 	atomic_set(&_adb_dev->error, 0);
+	adb_rx_flush(_adb_dev);
 
 	return 0;
 }
@@ -436,6 +573,8 @@ static struct file_operations adb_fops = {
 	.owner = THIS_MODULE,
 	.read = adb_read,
 	.write = adb_write,
+	.aio_read = adb_aio_read,
+	.aio_write = adb_aio_write,
 	.open = adb_open,
 	.release = adb_release,
 };
@@ -522,12 +661,14 @@ adb_function_unbind(struct usb_configuration *c, struct usb_function *f)
 	struct adb_dev	*dev = func_to_dev(f);
 	struct usb_request *req;
 
-	spin_lock_irq(&dev->lock);
-
-	adb_request_free(dev->rx_req, dev->ep_out);
+	/* req_get() takes dev->lock itself */
+	adb_rx_flush(dev);
+	while ((req = req_get(dev, &dev->rx_idle)))
+		adb_request_free(req, dev->ep_out);
 	while ((req = req_get(dev, &dev->tx_idle)))
 		adb_request_free(req, dev->ep_in);
 
+	spin_lock_irq(&dev->lock);
 	atomic_set(&dev->online, 0);
 	atomic_set(&dev->error, 1);
 	spin_unlock_irq(&dev->lock);
@@ -605,6 +746,8 @@ static int adb_bind_config(struct usb_configuration *c)
 	atomic_set(&dev->write_excl, 0);
 
 	INIT_LIST_HEAD(&dev->tx_idle);
+	INIT_LIST_HEAD(&dev->rx_idle);
+	INIT_LIST_HEAD(&dev->rx_done);
 
 	dev->cdev = c->cdev;
 	dev->function.name = "adb";
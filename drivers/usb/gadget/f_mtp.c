@@ -50,9 +50,9 @@
 #define STATE_CANCELED              3   /* transaction canceled by host */
 #define STATE_ERROR                 4   /* error from completion routine */
 
-/* number of tx and rx requests to allocate */
-#define TX_REQ_MAX 4
-#define RX_REQ_MAX 2
+/* upper bounds for the number of tx and rx requests */
+#define TX_REQ_MAX 32
+#define RX_REQ_MAX 8
 
 /* ID for Microsoft MTP OS String */
 #define MTP_OS_STRING_ID   0xEE
@@ -69,6 +69,23 @@
 
 static const char shortname[] = "mtp_usb";
 
+/* Request depth and size for the bulk endpoints, applied at bind time.
+ * Requests larger than BULK_BUFFER_SIZE need a controller that takes
+ * them (msm72k_udc does not); allocation falls back to the default.
+ * rx requests are at least BULK_BUFFER_SIZE.
+ */
+static unsigned int mtp_tx_reqs = 8;
+module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
+
+static unsigned int mtp_rx_reqs = 4;
+module_param(mtp_rx_reqs, uint, S_IRUGO | S_IWUSR);
+
+static unsigned int mtp_tx_req_len = BULK_BUFFER_SIZE;
+module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
+
+static unsigned int mtp_rx_req_len = BULK_BUFFER_SIZE;
+module_param(mtp_rx_req_len, uint, S_IRUGO | S_IWUSR);
+
 struct mtp_dev {
 	struct usb_function function;
 	struct usb_composite_dev *cdev;
@@ -96,6 +113,12 @@ struct mtp_dev {
 	struct usb_request *rx_req[RX_REQ_MAX];
 	struct usb_request *intr_req;
 	int rx_done;
+	/* OUT completions, for receive_file_work() */
+	atomic_t rx_completed;
+
+	unsigned int rx_req_count;
+	unsigned int tx_req_len;
+	unsigned int rx_req_len;
 	/* true if interrupt endpoint is busy */
 	int intr_busy;
 
@@ -363,6 +386,7 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 	struct mtp_dev *dev = _mtp_dev;
 
 	dev->rx_done = 1;
+	atomic_inc(&dev->rx_completed);
 	if (req->status != 0)
 		dev->state = STATE_ERROR;
 
@@ -430,17 +454,42 @@ static int __init create_bulk_endpoints(struct mtp_dev *dev,
 	dev->ep_intr = ep;
 
 	/* now allocate requests for our endpoints */
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_in, BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+	/* whole high speed packets, so only the last read can be short;
+	 * rx requests must also take the BULK_BUFFER_SIZE reads that MTP
+	 * userspace makes, so they are never made smaller than that
+	 */
+	dev->tx_req_len = max(mtp_tx_req_len & ~511U, 512U);
+	dev->rx_req_len = max(mtp_rx_req_len & ~511U,
+			      (unsigned int)BULK_BUFFER_SIZE);
+	dev->rx_req_count = clamp(mtp_rx_reqs, 1U, (unsigned int)RX_REQ_MAX);
+
+retry_tx_alloc:
+	for (i = 0; i < clamp(mtp_tx_reqs, 1U, (unsigned int)TX_REQ_MAX); i++) {
+		req = mtp_request_new(dev->ep_in, dev->tx_req_len);
+		if (!req) {
+			if (dev->tx_req_len <= BULK_BUFFER_SIZE)
+				goto fail;
+			while ((req = req_get(dev, &dev->tx_idle)))
+				mtp_request_free(req, dev->ep_in);
+			dev->tx_req_len = BULK_BUFFER_SIZE;
+			goto retry_tx_alloc;
+		}
 		req->complete = mtp_complete_in;
 		req_put(dev, &dev->tx_idle, req);
 	}
-	for (i = 0; i < RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+retry_rx_alloc:
+	for (i = 0; i < dev->rx_req_count; i++) {
+		req = mtp_request_new(dev->ep_out, dev->rx_req_len);
+		if (!req) {
+			if (dev->rx_req_len <= BULK_BUFFER_SIZE)
+				goto fail;
+			while (i--) {
+				mtp_request_free(dev->rx_req[i], dev->ep_out);
+				dev->rx_req[i] = NULL;
+			}
+			dev->rx_req_len = BULK_BUFFER_SIZE;
+			goto retry_rx_alloc;
+		}
 		req->complete = mtp_complete_out;
 		dev->rx_req[i] = req;
 	}
@@ -468,7 +517,7 @@ static ssize_t mtp_read(struct file *fp, char __user *buf,
 
 	DBG(cdev, "mtp_read(%d)\n", count);
 
-	if (count > BULK_BUFFER_SIZE)
+	if (count > dev->rx_req_len)
 		return -EINVAL;
 
 	/* we will block until we're online */
@@ -587,8 +636,8 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 			break;
 		}
 
-		if (count > BULK_BUFFER_SIZE)
-			xfer = BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 		if (xfer && copy_from_user(req->buf, buf, xfer)) {
@@ -671,8 +720,8 @@ static void send_file_work(struct work_struct *data) {
 			break;
 		}
 
-		if (count > BULK_BUFFER_SIZE)
-			xfer = BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 		ret = vfs_read(filp, req->buf, xfer, &offset);
@@ -711,11 +760,12 @@ static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev	*dev = container_of(data, struct mtp_dev, receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *req;
 	struct file *filp;
 	loff_t offset;
 	int64_t count;
-	int ret, cur_buf = 0;
+	int ret, depth, head = 0, tail = 0, queued = 0;
+	int done = 0;
 	int r = 0;
 
 	/* read our parameters */
@@ -726,62 +776,82 @@ static void receive_file_work(struct work_struct *data)
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
-
-			read_req->length = (count > BULK_BUFFER_SIZE
-					? BULK_BUFFER_SIZE : count);
-			dev->rx_done = 0;
-			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
+	/* Keep reads queued while writing to the file, so the host can
+	 * stream.  If xfer_file_length is 0xFFFFFFFF the transfer ends with
+	 * a short packet, and a read queued past it could take the next
+	 * command: use a single request then.
+	 */
+	depth = (count == 0xFFFFFFFF) ? 1 : dev->rx_req_count;
+	atomic_set(&dev->rx_completed, 0);
+
+	while (count > 0 || queued) {
+		while (count > 0 && queued < depth) {
+			req = dev->rx_req[tail];
+			req->length = (count > dev->rx_req_len
+					? dev->rx_req_len : count);
+			ret = usb_ep_queue(dev->ep_out, req, GFP_KERNEL);
 			if (ret < 0) {
 				r = -EIO;
 				dev->state = STATE_ERROR;
-				break;
+				goto cancel;
 			}
+			tail = (tail + 1) % depth;
+			queued++;
+			if (count != 0xFFFFFFFF)
+				count -= req->length;
 		}
 
-		if (write_req) {
-			DBG(cdev, "rx %p %d\n", write_req, write_req->actual);
-			ret = vfs_write(filp, write_req->buf, write_req->actual,
-				&offset);
-			DBG(cdev, "vfs_write %d\n", ret);
-			if (ret != write_req->actual) {
-				r = -EIO;
-				dev->state = STATE_ERROR;
-				break;
-			}
-			write_req = NULL;
+		/* wait for the oldest read to complete */
+		req = dev->rx_req[head];
+		ret = wait_event_interruptible(dev->read_wq,
+			atomic_read(&dev->rx_completed) != done
+			|| dev->state != STATE_BUSY);
+		if (dev->state == STATE_CANCELED) {
+			r = -ECANCELED;
+			goto cancel;
+		}
+		if (atomic_read(&dev->rx_completed) == done) {
+			r = ret ? ret : -EIO;
+			goto cancel;
+		}
+		done++;
+		head = (head + 1) % depth;
+		queued--;
+		if (req->status) {
+			r = -EIO;
+			goto cancel;
 		}
 
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED) {
-				r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
-			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/* short packet is used to signal EOF for sizes > 4 gig */
-				DBG(cdev, "got short packet\n");
-				count = 0;
-			}
+		DBG(cdev, "rx %p %d\n", req, req->actual);
+		ret = vfs_write(filp, req->buf, req->actual, &offset);
+		DBG(cdev, "vfs_write %d\n", ret);
+		if (ret != req->actual) {
+			r = -EIO;
+			dev->state = STATE_ERROR;
+			goto cancel;
+		}
 
-			write_req = read_req;
-			read_req = NULL;
+		if (req->actual < req->length) {
+			/* short packet is used to signal EOF for sizes > 4 gig */
+			DBG(cdev, "got short packet\n");
+			count = 0;
+			goto cancel;
 		}
 	}
 
+cancel:
+	/* take back reads queued past the end or an error */
+	if (queued) {
+		int i;
+
+		for (i = 0; i < queued; i++)
+			usb_ep_dequeue(dev->ep_out,
+				dev->rx_req[(head + i) % depth]);
+		wait_event_timeout(dev->read_wq,
+			atomic_read(&dev->rx_completed) >= done + queued,
+			HZ);
+	}
+
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
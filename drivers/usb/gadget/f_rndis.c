@@ -98,6 +98,19 @@ struct f_rndis {
 	atomic_t			notify_count;
 };
 
+/* RNDIS packet messages per transfer: OUT as reported to the host, IN
+ * as sent by u_ether (which also bounds IN by the host's transfer size).
+ */
+static unsigned int rndis_ul_max_pkt_per_xfer = 3;
+module_param(rndis_ul_max_pkt_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_ul_max_pkt_per_xfer,
+		"max packets per OUT transfer");
+
+static unsigned int rndis_dl_max_pkt_per_xfer = 10;
+module_param(rndis_dl_max_pkt_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_dl_max_pkt_per_xfer,
+		"max packets per IN transfer");
+
 static inline struct f_rndis *func_to_rndis(struct usb_function *f)
 {
 	return container_of(f, struct f_rndis, port.func);
@@ -414,6 +427,12 @@ static void rndis_command_complete(struct usb_ep *ep, struct usb_request *req)
 	/* received RNDIS command from USB_CDC_SEND_ENCAPSULATED_COMMAND */
 //	spin_lock(&dev->lock);
 	status = rndis_msg_parser(rndis->config, (u8 *) req->buf);
+
+	/* INITIALIZE tells how large IN transfers the host can take */
+	if (status >= 0 && *(__le32 *)req->buf
+			== cpu_to_le32(REMOTE_NDIS_INITIALIZE_MSG))
+		gether_update_dl_max_xfer_size(&rndis->port,
+			rndis_get_dl_max_xfer_size(rndis->config));
 	/* In some pc, the rndis command is come before rndis bind.
 	 * It will result to mobile reset for the cdev is NULL.
 	 */
@@ -566,6 +585,15 @@ static int rndis_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 		 */
 		rndis->port.cdc_filter = 0;
 
+		/* several packet messages per transfer, both ways */
+		rndis->port.ul_max_pkts_per_xfer = rndis_ul_max_pkt_per_xfer;
+		rndis->port.dl_max_pkts_per_xfer = rndis_dl_max_pkt_per_xfer;
+		rndis->port.multi_pkt_xfer = rndis_ul_max_pkt_per_xfer > 1
+			|| rndis_dl_max_pkt_per_xfer > 1;
+		rndis_set_max_pkt_xfer(rndis->config,
+				rndis->port.multi_pkt_xfer
+				? rndis->port.ul_max_pkts_per_xfer : 1);
+
 		DBG(cdev, "RNDIS RX/TX early activation ... \n");
 		net = gether_connect(&rndis->port);
 		if (IS_ERR(net))
@@ -573,6 +601,9 @@ static int rndis_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 
 		rndis_set_param_dev(rndis->config, net,
 				&rndis->port.cdc_filter);
+		/* in case the host initialized RNDIS before this reset */
+		gether_update_dl_max_xfer_size(&rndis->port,
+			rndis_get_dl_max_xfer_size(rndis->config));
 	} else
 		goto fail;
 
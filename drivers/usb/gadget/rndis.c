@@ -592,6 +592,9 @@ static int rndis_init_response(int configNr, rndis_init_msg_type *buf)
 	if (!params->dev)
 		return -ENOTSUPP;
 
+	/* largest transfer the host accepts, bounds IN aggregation */
+	params->dl_max_xfer_size = le32_to_cpu(buf->MaxTransferSize);
+
 	r = rndis_add_response(configNr, sizeof(rndis_init_cmplt_type));
 	if (!r)
 		return -ENOMEM;
@@ -605,11 +608,11 @@ static int rndis_init_response(int configNr, rndis_init_msg_type *buf)
 	resp->MinorVersion = cpu_to_le32(RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = cpu_to_le32(RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = cpu_to_le32(RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = cpu_to_le32(1);
-	resp->MaxTransferSize = cpu_to_le32(
-		  params->dev->mtu
+	resp->MaxPacketsPerTransfer = cpu_to_le32(params->max_pkt_per_xfer);
+	resp->MaxTransferSize = cpu_to_le32(params->max_pkt_per_xfer *
+		(params->dev->mtu
 		+ sizeof(struct ethhdr)
-		+ sizeof(struct rndis_packet_msg_type)
+		+ sizeof(struct rndis_packet_msg_type))
 		+ 22);
 	resp->PacketAlignmentFactor = cpu_to_le32(0);
 	resp->AFListOffset = cpu_to_le32(0);
@@ -920,6 +923,8 @@ int rndis_register(void (*resp_avail)(void *v), void *v)
 	for (i = 0; i < RNDIS_MAX_CONFIGS; i++) {
 		if (!rndis_per_dev_params[i].used) {
 			rndis_per_dev_params[i].used = 1;
+			rndis_per_dev_params[i].max_pkt_per_xfer = 1;
+			rndis_per_dev_params[i].dl_max_xfer_size = 0;
 			rndis_per_dev_params[i].resp_avail = resp_avail;
 			rndis_per_dev_params[i].v = v;
 			pr_debug("%s: configNr = %d\n", __func__, i);
@@ -975,6 +980,26 @@ int rndis_set_param_medium(u8 configNr, u32 medium, u32 speed)
 	return 0;
 }
 
+/* OUT transfers may carry up to @max_pkt_per_xfer packet messages */
+int rndis_set_max_pkt_xfer(u8 configNr, u32 max_pkt_per_xfer)
+{
+	pr_debug("%s: %u\n", __func__, max_pkt_per_xfer);
+	if (configNr >= RNDIS_MAX_CONFIGS) return -1;
+
+	rndis_per_dev_params[configNr].max_pkt_per_xfer =
+		max_t(u32, max_pkt_per_xfer, 1);
+
+	return 0;
+}
+
+/* 0 until the host has sent REMOTE_NDIS_INITIALIZE_MSG */
+u32 rndis_get_dl_max_xfer_size(u8 configNr)
+{
+	if (configNr >= RNDIS_MAX_CONFIGS) return 0;
+
+	return rndis_per_dev_params[configNr].dl_max_xfer_size;
+}
+
 void rndis_add_hdr(struct sk_buff *skb)
 {
 	struct rndis_packet_msg_type *header;
@@ -1043,30 +1068,66 @@ static rndis_resp_t *rndis_add_response(int configNr, u32 length)
 	return r;
 }
 
+/*
+ * Hosts may pack several packet messages into one OUT transfer (up to
+ * the MaxPacketsPerTransfer we reported), each one starting where the
+ * MessageLength of the previous one ends.  All but the last are split
+ * off as clones sharing the transfer's buffer.
+ */
 int rndis_rm_hdr(struct gether *port,
 			struct sk_buff *skb,
 			struct sk_buff_head *list)
 {
-	/* tmp points to a struct rndis_packet_msg_type */
-	__le32 *tmp = (void *)skb->data;
+	struct sk_buff	*skb2;
+	u32		msg_len, data_offset, data_len;
+	bool		first = true;
+
+	for (;;) {
+		/* tmp points to a struct rndis_packet_msg_type */
+		__le32 *tmp = (void *)skb->data;
+
+		/* MessageType, MessageLength */
+		if (skb->len < sizeof(struct rndis_packet_msg_type) ||
+		    cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+				!= get_unaligned(tmp++)) {
+			dev_kfree_skb_any(skb);
+			/* anything after the first message may be padding */
+			return first ? -EINVAL : 0;
+		}
+		msg_len = get_unaligned_le32(tmp++);
+
+		/* DataOffset, DataLength */
+		data_offset = get_unaligned_le32(tmp++);
+		data_len = get_unaligned_le32(tmp++);
+		/* bound each field on its own so the sum cannot wrap */
+		if (data_offset > skb->len - 8 ||
+		    data_len > skb->len - 8 - data_offset ||
+		    msg_len < data_offset + 8 + data_len) {
+			dev_kfree_skb_any(skb);
+			return -EOVERFLOW;
+		}
 
-	/* MessageType, MessageLength */
-	if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
-			!= get_unaligned(tmp++)) {
-		dev_kfree_skb_any(skb);
-		return -EINVAL;
-	}
-	tmp++;
+		/* last (usually only) message: reuse the skb */
+		if (msg_len >= skb->len ||
+		    skb->len - msg_len < sizeof(struct rndis_packet_msg_type)) {
+			skb_pull(skb, data_offset + 8);
+			skb_trim(skb, data_len);
+			skb_queue_tail(list, skb);
+			return 0;
+		}
 
-	/* DataOffset, DataLength */
-	if (!skb_pull(skb, get_unaligned_le32(tmp++) + 8)) {
-		dev_kfree_skb_any(skb);
-		return -EOVERFLOW;
-	}
-	skb_trim(skb, get_unaligned_le32(tmp++));
+		skb2 = skb_clone(skb, GFP_ATOMIC);
+		if (!skb2) {
+			dev_kfree_skb_any(skb);
+			return -ENOMEM;
+		}
+		skb_pull(skb2, data_offset + 8);
+		skb_trim(skb2, data_len);
+		skb_queue_tail(list, skb2);
 
-	skb_queue_tail(list, skb);
-	return 0;
+		skb_pull(skb, msg_len);
+		first = false;
+	}
 }
 
 #ifdef CONFIG_USB_GADGET_DEBUG_FILES
@@ -24,6 +24,8 @@
 
 #include <linux/kernel.h>
 #include <linux/gfp.h>
+#include <linux/slab.h>
+#include <linux/hrtimer.h>
 #include <linux/device.h>
 #include <linux/ctype.h>
 #include <linux/etherdevice.h>
@@ -70,6 +72,9 @@ struct eth_dev {
 	atomic_t		tx_qlen;
 
 	struct sk_buff_head	rx_frames;
+	struct napi_struct	napi;
+	struct sk_buff_pool	rx_pool;	/* see rx_recycle */
+	unsigned		rx_buf_len;	/* size rx_submit() allocates */
 
 	unsigned		header_len;
 	struct sk_buff		*(*wrap)(struct gether *, struct sk_buff *skb);
@@ -84,11 +89,23 @@ struct eth_dev {
 
 	bool			zlp;
 	u8			host_mac[ETH_ALEN];
+
+	/* several frames per transfer, see tx_aggr_xmit() */
+	bool			tx_aggr;
+	unsigned		tx_aggr_max_len;	/* buffer size */
+	unsigned		tx_frame_max;
+	unsigned		dl_max_pkts_per_xfer;
+	unsigned		dl_max_xfer_size;	/* host's limit */
+	unsigned		ul_max_pkts_per_xfer;
+	struct usb_request	*tx_aggr_req;		/* being filled */
+	unsigned		tx_aggr_count;
+	struct hrtimer		tx_aggr_timer;
 };
 
 /*-------------------------------------------------------------------------*/
 
 #define RX_EXTRA	20	/* bytes guarding against rx overflows */
+#define RX_NAPI_WEIGHT	64	/* frames handed up per poll */
 
 /* increase the rndis tx list buffer for reducing the wait time of net queue  */
 #ifdef CONFIG_HUAWEI_KERNEL
@@ -117,6 +134,20 @@ static inline int qlen(struct usb_gadget *gadget)
 		return DEFAULT_QLEN;
 }
 
+/* IN transfer size and latency bounds for links that aggregate frames */
+static unsigned aggr_max_size = 16384;
+module_param(aggr_max_size, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(aggr_max_size, "max bytes of frames per IN transfer");
+
+static unsigned aggr_flush_us = 1000;
+module_param(aggr_flush_us, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(aggr_flush_us, "max usecs a frame waits for others");
+
+/* sent frames large enough to receive into are kept for rx_submit() */
+static unsigned rx_recycle = 16;
+module_param(rx_recycle, uint, S_IRUGO);
+MODULE_PARM_DESC(rx_recycle, "rx buffers kept for reuse, 0 to disable");
+
 /*-------------------------------------------------------------------------*/
 
 /* REVISIT there must be a better way than having two sets
@@ -191,11 +222,56 @@ static void eth_get_drvinfo(struct net_device *net, struct ethtool_drvinfo *p)
  *   - ... probably more ethtool ops
  */
 
+static const char eth_stats_strings[][ETH_GSTRING_LEN] = {
+	"rx_recycle_hits",
+	"rx_recycle_misses",
+	"rx_recycled",
+	"rx_recycle_rejected",
+};
+
+static int eth_get_sset_count(struct net_device *net, int sset)
+{
+	switch (sset) {
+	case ETH_SS_STATS:
+		return ARRAY_SIZE(eth_stats_strings);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static void eth_get_strings(struct net_device *net, u32 sset, u8 *data)
+{
+	if (sset == ETH_SS_STATS)
+		memcpy(data, eth_stats_strings, sizeof eth_stats_strings);
+}
+
+static void eth_get_ethtool_stats(struct net_device *net,
+		struct ethtool_stats *stats, u64 *data)
+{
+	struct eth_dev	*dev = netdev_priv(net);
+
+	data[0] = dev->rx_pool.hits;
+	data[1] = dev->rx_pool.misses;
+	data[2] = dev->rx_pool.recycled;
+	data[3] = dev->rx_pool.rejected;
+}
+
 static const struct ethtool_ops ops = {
 	.get_drvinfo = eth_get_drvinfo,
 	.get_link = ethtool_op_get_link,
+	.get_sset_count = eth_get_sset_count,
+	.get_strings = eth_get_strings,
+	.get_ethtool_stats = eth_get_ethtool_stats,
 };
 
+/* the frame came from the stack or from rx_submit(), either may serve
+ * as a later rx buffer
+ */
+static inline void eth_free_skb(struct eth_dev *dev, struct sk_buff *skb)
+{
+	skb_pool_recycle(&dev->rx_pool, skb, dev->rx_buf_len + NET_IP_ALIGN);
+}
+
 static void defer_kevent(struct eth_dev *dev, int flag)
 {
 	if (test_and_set_bit(flag, &dev->todo))
@@ -242,13 +318,15 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+	size *= dev->ul_max_pkts_per_xfer;
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
 	if (dev->port_usb->is_fixed)
 		size = max(size, dev->port_usb->fixed_out_len);
 
-	skb = alloc_skb(size + NET_IP_ALIGN, gfp_flags);
+	dev->rx_buf_len = size;
+	skb = skb_pool_alloc(&dev->rx_pool, size + NET_IP_ALIGN, gfp_flags);
 	if (skb == NULL) {
 		DBG(dev, "no rx skb\n");
 		goto enomem;
@@ -272,7 +350,7 @@ enomem:
 	if (retval) {
 		DBG(dev, "rx submit --> %d\n", retval);
 		if (skb)
-			dev_kfree_skb_any(skb);
+			eth_free_skb(dev, skb);
 		spin_lock_irqsave(&dev->req_lock, flags);
 		list_add(&req->list, &dev->rx_reqs);
 		spin_unlock_irqrestore(&dev->req_lock, flags);
@@ -280,58 +358,51 @@ enomem:
 	return retval;
 }
 
+/*
+ * Completions only queue the received frames and the request itself;
+ * eth_napi_poll() hands the frames to the stack and resubmits requests.
+ */
 static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct sk_buff	*skb = req->context, *skb2;
+	struct sk_buff	*skb = req->context;
 	struct eth_dev	*dev = ep->driver_data;
 	int		status = req->status;
+	struct sk_buff_head frames;
+	unsigned long	flags;
 
 	switch (status) {
 
 	/* normal completion */
 	case 0:
 		skb_put(skb, req->actual);
+		skb_queue_head_init(&frames);
 
 		if (dev->unwrap) {
-			unsigned long	flags;
-
 			spin_lock_irqsave(&dev->lock, flags);
 			if (dev->port_usb) {
 				status = dev->unwrap(dev->port_usb,
 							skb,
-							&dev->rx_frames);
+							&frames);
 			} else {
 				dev_kfree_skb_any(skb);
 				status = -ENOTCONN;
 			}
 			spin_unlock_irqrestore(&dev->lock, flags);
 		} else {
-			skb_queue_tail(&dev->rx_frames, skb);
+			__skb_queue_tail(&frames, skb);
 		}
 		skb = NULL;
 
-		skb2 = skb_dequeue(&dev->rx_frames);
-		while (skb2) {
-			if (status < 0
-					|| ETH_HLEN > skb2->len
-					|| skb2->len > ETH_FRAME_LEN) {
-				dev->net->stats.rx_errors++;
-				dev->net->stats.rx_length_errors++;
-				DBG(dev, "rx length %d\n", skb2->len);
-				dev_kfree_skb_any(skb2);
-				goto next_frame;
-			}
-			skb2->protocol = eth_type_trans(skb2, dev->net);
-			dev->net->stats.rx_packets++;
-			dev->net->stats.rx_bytes += skb2->len;
-
-			/* no buffer copies needed, unless hardware can't
-			 * use skb buffers.
-			 */
-			status = netif_rx(skb2);
-next_frame:
-			skb2 = skb_dequeue(&dev->rx_frames);
+		if (status < 0) {
+			dev->net->stats.rx_errors++;
+			DBG(dev, "rx unwrap %d\n", status);
+			skb_queue_purge(&frames);
+			break;
 		}
+
+		spin_lock_irqsave(&dev->rx_frames.lock, flags);
+		skb_queue_splice_tail(&frames, &dev->rx_frames);
+		spin_unlock_irqrestore(&dev->rx_frames.lock, flags);
 		break;
 
 	/* software-driven interface shutdown */
@@ -360,16 +431,19 @@ quiesce:
 	}
 
 	if (skb)
-		dev_kfree_skb_any(skb);
-	if (!netif_running(dev->net)) {
+		eth_free_skb(dev, skb);
+	spin_lock(&dev->req_lock);
+	list_add(&req->list, &dev->rx_reqs);
+	spin_unlock(&dev->req_lock);
+
+	/* no-op while the interface is down */
+	napi_schedule(&dev->napi);
+	return;
+
 clean:
-		spin_lock(&dev->req_lock);
-		list_add(&req->list, &dev->rx_reqs);
-		spin_unlock(&dev->req_lock);
-		req = NULL;
-	}
-	if (req)
-		rx_submit(dev, req, GFP_ATOMIC);
+	spin_lock(&dev->req_lock);
+	list_add(&req->list, &dev->rx_reqs);
+	spin_unlock(&dev->req_lock);
 }
 
 static int prealloc(struct list_head *list, struct usb_ep *ep, unsigned n)
@@ -411,6 +485,27 @@ extra:
 	return 0;
 }
 
+/* aggregating links copy frames into buffers owned by the tx requests */
+static int alloc_tx_buffers(struct eth_dev *dev)
+{
+	struct usb_request	*req;
+
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		/* one spare byte, see tx_aggr_queue() */
+		req->buf = kmalloc(dev->tx_aggr_max_len + 1, GFP_ATOMIC);
+		if (!req->buf)
+			goto fail;
+	}
+	return 0;
+
+fail:
+	list_for_each_entry_continue_reverse(req, &dev->tx_reqs, list) {
+		kfree(req->buf);
+		req->buf = NULL;
+	}
+	return -ENOMEM;
+}
+
 static int alloc_requests(struct eth_dev *dev, struct gether *link, unsigned n)
 {
 	int	status;
@@ -419,6 +514,10 @@ static int alloc_requests(struct eth_dev *dev, struct gether *link, unsigned n)
 	status = prealloc(&dev->tx_reqs, link->in_ep, n);
 	if (status < 0)
 		goto fail;
+	if (dev->tx_aggr && alloc_tx_buffers(dev) < 0) {
+		DBG(dev, "no tx aggregation buffers\n");
+		dev->tx_aggr = false;
+	}
 	status = prealloc(&dev->rx_reqs, link->out_ep, n);
 	if (status < 0)
 		goto fail;
@@ -453,6 +552,47 @@ static void rx_fill(struct eth_dev *dev, gfp_t gfp_flags)
 	spin_unlock_irqrestore(&dev->req_lock, flags);
 }
 
+static int eth_napi_poll(struct napi_struct *napi, int budget)
+{
+	struct eth_dev	*dev = container_of(napi, struct eth_dev, napi);
+	struct sk_buff	*skb;
+	int		work_done = 0;
+
+	while (work_done < budget
+			&& (skb = skb_dequeue(&dev->rx_frames)) != NULL) {
+		if (ETH_HLEN > skb->len || skb->len > ETH_FRAME_LEN) {
+			dev->net->stats.rx_errors++;
+			dev->net->stats.rx_length_errors++;
+			DBG(dev, "rx length %d\n", skb->len);
+			eth_free_skb(dev, skb);
+			continue;
+		}
+		skb->protocol = eth_type_trans(skb, dev->net);
+		dev->net->stats.rx_packets++;
+		dev->net->stats.rx_bytes += skb->len;
+
+		napi_gro_receive(napi, skb);
+		work_done++;
+	}
+
+	/* resubmit completed requests, unless the stack is falling
+	 * behind: then the host waits rather than the backlog growing
+	 */
+	if (netif_carrier_ok(dev->net)
+			&& skb_queue_len(&dev->rx_frames) < budget)
+		rx_fill(dev, GFP_ATOMIC);
+
+	if (work_done < budget) {
+		napi_complete(napi);
+		/* rx_complete() may have queued frames after the last
+		 * dequeue, while its napi_schedule() was a no-op
+		 */
+		if (!skb_queue_empty(&dev->rx_frames))
+			napi_schedule(napi);
+	}
+	return work_done;
+}
+
 static void eth_work(struct work_struct *work)
 {
 	struct eth_dev	*dev = container_of(work, struct eth_dev, work);
@@ -466,30 +606,41 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static void tx_aggr_flush(struct eth_dev *dev, struct usb_ep *in);
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct sk_buff	*skb = req->context;
+	struct sk_buff	*skb = req->context;	/* NULL if aggregated */
 	struct eth_dev	*dev = ep->driver_data;
+	int		status = req->status;
 
-	switch (req->status) {
+	switch (status) {
 	default:
 		dev->net->stats.tx_errors++;
-		VDBG(dev, "tx err %d\n", req->status);
+		VDBG(dev, "tx err %d\n", status);
 		/* FALLTHROUGH */
 	case -ECONNRESET:		/* unlink */
 	case -ESHUTDOWN:		/* disconnect etc */
 		break;
 	case 0:
-		dev->net->stats.tx_bytes += skb->len;
+		if (skb)
+			dev->net->stats.tx_bytes += skb->len;
 	}
-	dev->net->stats.tx_packets++;
 
 	spin_lock(&dev->req_lock);
 	list_add(&req->list, &dev->tx_reqs);
 	spin_unlock(&dev->req_lock);
-	dev_kfree_skb_any(skb);
+	if (skb) {
+		dev->net->stats.tx_packets++;
+		eth_free_skb(dev, skb);
+	}
 
 	atomic_dec(&dev->tx_qlen);
+
+	/* frames gathered while this transfer was pending go out now */
+	if (!skb && !status)
+		tx_aggr_flush(dev, ep);
+
 	if (netif_carrier_ok(dev->net))
 		netif_wake_queue(dev->net);
 }
@@ -499,6 +650,183 @@ static inline int is_promisc(u16 cdc_filter)
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
 }
 
+/*
+ * TX aggregation, for links with multi_pkt_xfer: wrapped frames are
+ * copied into the buffer of the request being filled.  It is queued as
+ * soon as it holds dl_max_pkts_per_xfer frames or a full sized frame
+ * might not fit any more (aggr_max_size, or the host's limit).  It is
+ * also queued right away while no other IN transfer is pending, when
+ * one completes, and at the latest aggr_flush_us after it was started,
+ * so frames only wait while the link is busy anyway.
+ */
+
+/* caller holds req_lock */
+static struct usb_request *tx_aggr_take(struct eth_dev *dev)
+{
+	struct usb_request	*req = dev->tx_aggr_req;
+
+	dev->tx_aggr_req = NULL;
+	dev->tx_aggr_count = 0;
+	return req;
+}
+
+static void tx_aggr_queue(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req)
+{
+	unsigned long	flags;
+	int		retval;
+
+	/* same zlp rules as for single frames, see eth_start_xmit() */
+	req->zero = 1;
+	if (!dev->zlp && (req->length % in->maxpacket) == 0)
+		req->length++;
+
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	if (!retval) {
+		dev->net->trans_start = jiffies;
+		atomic_inc(&dev->tx_qlen);
+		return;
+	}
+
+	DBG(dev, "tx queue err %d\n", retval);
+	dev->net->stats.tx_dropped++;
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (list_empty(&dev->tx_reqs) && !dev->tx_aggr_req)
+		netif_start_queue(dev->net);
+	list_add(&req->list, &dev->tx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
+
+static void tx_aggr_flush(struct eth_dev *dev, struct usb_ep *in)
+{
+	struct usb_request	*req;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = tx_aggr_take(dev);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (req)
+		tx_aggr_queue(dev, in, req);
+}
+
+static enum hrtimer_restart tx_aggr_timeout(struct hrtimer *timer)
+{
+	struct eth_dev	*dev = container_of(timer, struct eth_dev,
+						tx_aggr_timer);
+	struct usb_ep	*in = NULL;
+	unsigned long	flags;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->port_usb)
+		in = dev->port_usb->in_ep;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	if (in)
+		tx_aggr_flush(dev, in);
+	return HRTIMER_NORESTART;
+}
+
+/* forget a partly filled transfer; call without dev->lock held */
+static void tx_aggr_discard(struct eth_dev *dev)
+{
+	struct usb_request	*req;
+	unsigned long		flags;
+
+	hrtimer_cancel(&dev->tx_aggr_timer);
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	dev->net->stats.tx_dropped += dev->tx_aggr_count;
+	req = tx_aggr_take(dev);
+	if (req)
+		list_add(&req->list, &dev->tx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
+
+static netdev_tx_t tx_aggr_xmit(struct eth_dev *dev, struct sk_buff *skb,
+		struct usb_ep *in)
+{
+	struct usb_request	*req, *full = NULL, *send = NULL;
+	unsigned long		flags;
+	unsigned		max_len;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	/* see eth_start_xmit() */
+	if (!dev->tx_aggr_req && list_empty(&dev->tx_reqs)) {
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		return NETDEV_TX_BUSY;
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (dev->wrap) {
+		spin_lock_irqsave(&dev->lock, flags);
+		if (dev->port_usb)
+			skb = dev->wrap(dev->port_usb, skb);
+		spin_unlock_irqrestore(&dev->lock, flags);
+		if (!skb) {
+			dev->net->stats.tx_dropped++;
+			return NETDEV_TX_OK;
+		}
+	}
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	max_len = min(dev->tx_aggr_max_len, dev->dl_max_xfer_size);
+	/* keep room for the pad byte tx_aggr_queue() may add */
+	if (!dev->zlp)
+		max_len--;
+
+	/* only if the host's limit shrank, or for oversized frames */
+	req = dev->tx_aggr_req;
+	if (req && req->length + skb->len > max_len) {
+		full = tx_aggr_take(dev);
+		req = NULL;
+	}
+
+	if (!req && !list_empty(&dev->tx_reqs)
+			&& skb->len <= dev->tx_aggr_max_len) {
+		req = container_of(dev->tx_reqs.next,
+				struct usb_request, list);
+		list_del(&req->list);
+		req->length = 0;
+		req->context = NULL;
+		req->complete = tx_complete;
+		req->no_interrupt = 0;
+		dev->tx_aggr_req = req;
+	}
+
+	if (req) {
+		memcpy(req->buf + req->length, skb->data, skb->len);
+		req->length += skb->len;
+		dev->tx_aggr_count++;
+		dev->net->stats.tx_packets++;
+		dev->net->stats.tx_bytes += skb->len;
+
+		if (dev->tx_aggr_count >= dev->dl_max_pkts_per_xfer
+				|| req->length + dev->tx_frame_max > max_len
+				|| (!full && !atomic_read(&dev->tx_qlen)))
+			send = tx_aggr_take(dev);
+		else if (!hrtimer_is_queued(&dev->tx_aggr_timer))
+			hrtimer_start(&dev->tx_aggr_timer,
+				ns_to_ktime((u64)aggr_flush_us * NSEC_PER_USEC),
+				HRTIMER_MODE_REL);
+	} else {
+		dev->net->stats.tx_dropped++;
+	}
+
+	/* temporarily stop TX queue when no request can take frames */
+	if (list_empty(&dev->tx_reqs) && !dev->tx_aggr_req)
+		netif_stop_queue(dev->net);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	eth_free_skb(dev, skb);
+
+	if (full)
+		tx_aggr_queue(dev, in, full);
+	if (send)
+		tx_aggr_queue(dev, in, send);
+	return NETDEV_TX_OK;
+}
+
 static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 					struct net_device *net)
 {
@@ -547,6 +875,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	if (dev->tx_aggr)
+		return tx_aggr_xmit(dev, skb, in);
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -652,6 +983,7 @@ static int eth_open(struct net_device *net)
 	struct gether	*link;
 
 	DBG(dev, "%s\n", __func__);
+	napi_enable(&dev->napi);
 	if (netif_carrier_ok(dev->net))
 		eth_start(dev, GFP_KERNEL);
 
@@ -671,6 +1003,8 @@ static int eth_stop(struct net_device *net)
 
 	VDBG(dev, "%s\n", __func__);
 	netif_stop_queue(net);
+	napi_disable(&dev->napi);
+	tx_aggr_discard(dev);
 
 	DBG(dev, "stop stats: rx/tx %ld/%ld, errs %ld/%ld\n",
 		dev->net->stats.rx_packets, dev->net->stats.tx_packets,
@@ -704,6 +1038,9 @@ static int eth_stop(struct net_device *net)
 	}
 	spin_unlock_irqrestore(&dev->lock, flags);
 
+	/* frames completed after napi_disable() */
+	skb_queue_purge(&dev->rx_frames);
+
 	return 0;
 }
 
@@ -787,12 +1124,17 @@ int gether_setup(struct usb_gadget *g, u8 ethaddr[ETH_ALEN])
 	INIT_WORK(&dev->work, eth_work);
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
+	hrtimer_init(&dev->tx_aggr_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dev->tx_aggr_timer.function = tx_aggr_timeout;
 
 	skb_queue_head_init(&dev->rx_frames);
+	skb_pool_init(&dev->rx_pool, rx_recycle);
 
 	/* network device setup */
 	dev->net = net;
 	strcpy(net->name, "usb%d");
+	netif_napi_add(net, &dev->napi, eth_napi_poll, RX_NAPI_WEIGHT);
+	net->features |= NETIF_F_GRO;
 
 	if (get_ether_addr(dev_addr, net->dev_addr))
 		dev_warn(&g->dev,
@@ -845,6 +1187,7 @@ void gether_cleanup(void)
 
 	unregister_netdev(the_dev->net);
 	flush_work_sync(&the_dev->work);
+	skb_pool_purge(&the_dev->rx_pool);
 	free_netdev(the_dev->net);
 
 	the_dev = NULL;
@@ -891,6 +1234,14 @@ struct net_device *gether_connect(struct gether *link)
 		goto fail1;
 	}
 
+	dev->tx_aggr = link->multi_pkt_xfer;
+	dev->tx_frame_max = ETH_HLEN + dev->net->mtu + link->header_len;
+	dev->tx_aggr_max_len = max(aggr_max_size, dev->tx_frame_max);
+	dev->dl_max_pkts_per_xfer = max(link->dl_max_pkts_per_xfer, 1U);
+	dev->dl_max_xfer_size = 0;
+	dev->ul_max_pkts_per_xfer = link->multi_pkt_xfer
+		? max(link->ul_max_pkts_per_xfer, 1U) : 1;
+
 	if (result == 0)
 		result = alloc_requests(dev, link, qlen(dev->gadget));
 
@@ -960,6 +1311,7 @@ void gether_disconnect(struct gether *link)
 	 * of all pending i/o.  then free the request objects
 	 * and forget about the endpoints.
 	 */
+	tx_aggr_discard(dev);
 	usb_ep_disable(link->in_ep);
 	spin_lock(&dev->req_lock);
 	while (!list_empty(&dev->tx_reqs)) {
@@ -968,6 +1320,8 @@ void gether_disconnect(struct gether *link)
 		list_del(&req->list);
 
 		spin_unlock(&dev->req_lock);
+		if (dev->tx_aggr)
+			kfree(req->buf);
 		usb_ep_free_request(link->in_ep, req);
 		spin_lock(&dev->req_lock);
 	}
@@ -994,9 +1348,32 @@ void gether_disconnect(struct gether *link)
 	dev->header_len = 0;
 	dev->unwrap = NULL;
 	dev->wrap = NULL;
+	dev->tx_aggr = false;
 
 	spin_lock(&dev->lock);
 	dev->port_usb = NULL;
 	link->ioport = NULL;
 	spin_unlock(&dev->lock);
 }
+
+/**
+ * gether_update_dl_max_xfer_size - set the host's IN transfer size limit
+ * @link: the USB link, on which gether_connect() was called
+ * @size: largest transfer the host accepts, in bytes
+ * Context: any
+ *
+ * Aggregating links (multi_pkt_xfer) send single frames until the host
+ * has told the function how large an IN transfer it can take.
+ */
+void gether_update_dl_max_xfer_size(struct gether *link, u32 size)
+{
+	struct eth_dev		*dev = link->ioport;
+	unsigned long		flags;
+
+	if (!dev)
+		return;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	dev->dl_max_xfer_size = size;
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
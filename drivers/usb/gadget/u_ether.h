@@ -71,6 +71,10 @@ struct gether {
 	int				(*unwrap)(struct gether *port,
 						struct sk_buff *skb,
 						struct sk_buff_head *list);
+	/* RNDIS can carry several wrapped frames per transfer */
+	bool				multi_pkt_xfer;
+	u32				ul_max_pkts_per_xfer;
+	u32				dl_max_pkts_per_xfer;
 
 	/* called on network open/close */
 	void				(*open)(struct gether *);
@@ -90,6 +94,7 @@ void gether_cleanup(void);
 /* connect/disconnect is handled by individual functions */
 struct net_device *gether_connect(struct gether *);
 void gether_disconnect(struct gether *);
+void gether_update_dl_max_xfer_size(struct gether *, u32);
 
 /* Some controllers can't support CDC Ethernet (ECM) ... */
 static inline bool can_support_ecm(struct usb_gadget *gadget)
@@ -37,6 +37,24 @@ struct sg_io_hdr;
 struct request;
 typedef void (rq_end_io_fn)(struct request *, int);
 
+#ifdef CONFIG_BLK_WRITE_THROTTLING
+/*
+ * Read latency driven limit on the number of buffered write requests
+ * a queue hands out. The window minimum of sync read completion times
+ * is compared against lat_target_us and depth is adjusted once per
+ * window.
+ */
+struct blk_wr_throttle {
+	unsigned int lat_target_us;	/* 0 disables throttling */
+	unsigned int win_msecs;
+	unsigned int depth;		/* max allocated async requests */
+	unsigned long win_start;	/* jiffies */
+	u64 win_min_ns;
+	unsigned int win_samples;
+	unsigned long nr_throttled;
+};
+#endif
+
 struct request_list {
 	/*
 	 * count[], starved[], and wait[] are indexed by
@@ -120,6 +138,9 @@ struct request {
 #ifdef CONFIG_BLK_CGROUP
 	unsigned long long start_time_ns;
 	unsigned long long io_start_time_ns;    /* when passed to hardware */
+#endif
+#ifdef CONFIG_BLK_WRITE_THROTTLING
+	u64 wrt_start_ns;	/* sync read allocation time, 0 if unsampled */
 #endif
 	/* Number of scatter-gather DMA addr+len pairs after
 	 * physical address coalescing is performed.
@@ -379,6 +400,10 @@ struct request_queue
 	/* Throttle data */
 	struct throtl_data *td;
 #endif
+
+#ifdef CONFIG_BLK_WRITE_THROTTLING
+	struct blk_wr_throttle	wrt;
+#endif
 };
 
 #define QUEUE_FLAG_QUEUED	1	/* uses generic tag queueing */
@@ -139,6 +139,17 @@ extern void put_online_cpus(void);
 #define unregister_hotcpu_notifier(nb)	unregister_cpu_notifier(nb)
 int cpu_down(unsigned int cpu);
 
+#ifdef CONFIG_HOTPLUG_CPU_PARK
+extern const struct cpumask *const cpu_parked_mask;
+#define cpu_parked(cpu)		cpumask_test_cpu((cpu), cpu_parked_mask)
+int cpu_park(unsigned int cpu);
+int cpu_unpark(unsigned int cpu);
+extern int sched_park_cpu(int cpu);
+extern void sched_unpark_cpu(int cpu);
+#else
+#define cpu_parked(cpu)		0
+#endif
+
 #ifdef CONFIG_ARCH_CPU_PROBE_RELEASE
 extern void cpu_hotplug_driver_lock(void);
 extern void cpu_hotplug_driver_unlock(void);
@@ -160,6 +171,7 @@ static inline void cpu_hotplug_driver_unlock(void)
 /* These aren't inline functions due to a GCC bug. */
 #define register_hotcpu_notifier(nb)	({ (void)(nb); 0; })
 #define unregister_hotcpu_notifier(nb)	({ (void)(nb); })
+#define cpu_parked(cpu)		0
 #endif		/* CONFIG_HOTPLUG_CPU */
 
 #ifdef CONFIG_PM_SLEEP_SMP
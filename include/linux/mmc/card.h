@@ -57,6 +57,9 @@ struct mmc_ext_csd {
 	unsigned int		sec_trim_mult;	/* Secure trim multiplier  */
 	unsigned int		sec_erase_mult;	/* Secure erase multiplier */
 	unsigned int		trim_timeout;		/* In milliseconds */
+	u8			max_packed_writes;
+	u8			max_packed_reads;
+	bool			packed_event_en;
 };
 
 struct sd_scr {
@@ -135,6 +138,38 @@ struct mmc_host;
 struct sdio_func;
 struct sdio_func_tuple;
 
+/*
+ * eMMC 4.5 packed commands.  The header is one sector: a word of
+ * version, type and entry count followed by a CMD23/CMD25 argument
+ * pair per entry.  It is sent ahead of the data of a CMD25 whose CMD23
+ * argument has MMC_CMD23_ARG_PACKED set.
+ */
+#define MMC_PACKED_HDR_SIZE	512
+#define MMC_PACKED_MAX_ENTRIES	(MMC_PACKED_HDR_SIZE / 8 - 1)
+
+#define MMC_PACKED_CMD_VER	0x01
+#define MMC_PACKED_CMD_WR	0x02
+
+#define MMC_PACKED_HDR(type, num) \
+	(((num) << 16) | ((type) << 8) | MMC_PACKED_CMD_VER)
+
+#define MMC_CMD23_ARG_PACKED	(1 << 30)
+
+/*
+ * Write packing statistics, kept up to date by the block driver and
+ * reported through debugfs.
+ */
+struct mmc_wr_pack_stats {
+	spinlock_t		lock;
+	unsigned long		single;		/* writes issued on their own */
+	unsigned long		packed;		/* packed write commands */
+	unsigned long		packed_reqs;	/* requests carried by them */
+	unsigned long		merged;		/* merged multiblock writes */
+	unsigned long		merged_reqs;	/* requests carried by them */
+	unsigned long		unpacked;	/* split up again after an error */
+	unsigned int		max_depth;	/* most requests in one command */
+};
+
 #define SDIO_MAX_FUNCS		7
 
 /*
@@ -176,6 +211,7 @@ struct mmc_card {
 	struct mmc_cid		cid;		/* card identification */
 	struct mmc_csd		csd;		/* card specific */
 	struct mmc_ext_csd	ext_csd;	/* mmc v4 extended card specific */
+	struct mmc_wr_pack_stats wr_pack_stats;	/* write packing statistics */
 	struct sd_scr		scr;		/* extra SD information */
 	struct sd_ssr		ssr;		/* yet more SD information */
 	struct sd_switch_caps	sw_caps;	/* switch (CMD6) caps */
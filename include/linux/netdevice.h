@@ -607,6 +607,7 @@ static inline void rps_reset_sock_flow(struct rps_sock_flow_table *table,
 }
 
 extern struct rps_sock_flow_table __rcu *rps_sock_flow_table;
+extern int rps_adaptive_thresh;
 
 /* This structure contains an instance of an RX queue. */
 struct netdev_rx_queue {
@@ -1496,6 +1497,12 @@ struct softnet_data {
 #ifdef CONFIG_RPS
 	struct softnet_data	*rps_ipi_list;
 
+	/* NET_RX load of this CPU, for adaptive steering */
+	u64			rx_window_start;
+	u64			rx_busy;
+	unsigned long		rps_adaptive_until;
+	bool			rps_adaptive;
+
 	/* Elements below can be accessed between CPUs for RPS */
 	struct call_single_data	csd ____cacheline_aligned_in_smp;
 	struct softnet_data	*rps_ipi_next;
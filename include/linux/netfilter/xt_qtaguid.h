@@ -0,0 +1,19 @@
+#ifndef _XT_QTAGUID_MATCH_H
+#define _XT_QTAGUID_MATCH_H
+
+#include <linux/types.h>
+
+/* Same layout and semantics as the owner match */
+enum {
+	XT_QTAGUID_UID    = 1 << 0,
+	XT_QTAGUID_GID    = 1 << 1,
+	XT_QTAGUID_SOCKET = 1 << 2,
+};
+
+struct xt_qtaguid_match_info {
+	__u32 uid_min, uid_max;
+	__u32 gid_min, gid_max;
+	__u8 match, invert;
+};
+
+#endif /* _XT_QTAGUID_MATCH_H */
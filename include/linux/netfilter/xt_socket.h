@@ -9,4 +9,16 @@ struct xt_socket_mtinfo1 {
 	__u8 flags;
 };
 
+#ifdef __KERNEL__
+struct sock;
+struct sk_buff;
+struct xt_action_param;
+
+extern struct sock *xt_socket_get4_sk(const struct sk_buff *skb,
+				      struct xt_action_param *par);
+extern struct sock *xt_socket_get6_sk(const struct sk_buff *skb,
+				      struct xt_action_param *par);
+extern void xt_socket_put_sk(struct sock *sk);
+#endif
+
 #endif /* _XT_SOCKET_H */
@@ -431,6 +431,10 @@ struct dev_pm_info {
 	struct list_head	entry;
 	struct completion	completion;
 	struct wakeup_source	*wakeup;
+	ktime_t			pm_start;	/* Owned by the PM core */
+	ktime_t			pm_end;
+	struct device		*pm_blocker;	/* dependency that finished last */
+	ktime_t			pm_blocker_end;
 #else
 	unsigned int		should_wakeup:1;
 #endif
@@ -141,6 +141,20 @@ extern unsigned long nr_iowait(void);
 extern unsigned long nr_iowait_cpu(int cpu);
 extern unsigned long this_cpu_load(void);
 
+#ifdef CONFIG_SCHED_NR_AVG
+struct sched_nr_avg {
+	u64 time;
+	u64 sum;
+};
+
+extern void sched_update_nr_prod(int cpu, unsigned long nr_running);
+extern unsigned int sched_get_nr_running_avg(struct sched_nr_avg *s);
+#else
+static inline void sched_update_nr_prod(int cpu, unsigned long nr_running)
+{
+}
+#endif
+
 
 extern void calc_global_load(unsigned long ticks);
 
@@ -1136,6 +1150,7 @@ struct sched_statistics {
 	u64			nr_wakeups_affine_attempts;
 	u64			nr_wakeups_passive;
 	u64			nr_wakeups_idle;
+	u64			nr_wakeups_packed;
 };
 #endif
 
@@ -1152,6 +1167,13 @@ struct sched_entity {
 
 	u64			nr_migrations;
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	/* cpu demand history, carried across migrations */
+	u64			demand_win_start;
+	u64			demand_runtime;
+	unsigned long		demand;
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	struct sched_statistics statistics;
 #endif
@@ -1928,6 +1950,8 @@ extern unsigned int sysctl_sched_nr_migrate;
 extern unsigned int sysctl_sched_time_avg;
 extern unsigned int sysctl_timer_migration;
 extern unsigned int sysctl_sched_shares_window;
+extern unsigned int sysctl_sched_small_task_pct;
+extern unsigned int sysctl_sched_pack_util_pct;
 
 int sched_proc_update_handler(struct ctl_table *table, int write,
 		void __user *buffer, size_t *length,
@@ -2539,6 +2563,25 @@ extern int sched_rt_can_attach(struct task_group *tg, struct task_struct *tsk);
 #endif
 #endif
 
+/* Reasons passed to the utilization hook */
+#define SCHED_UTIL_WAKEUP	0x1
+#define SCHED_UTIL_MIGRATE	0x2	/* work moved to this cpu */
+#define SCHED_UTIL_TICK		0x4
+#define SCHED_UTIL_MIGRATE_OUT	0x8	/* work moved away from this cpu */
+
+#ifdef CONFIG_SCHED_FREQ_INPUT
+/*
+ * Called without runqueue locks held when a wakeup, migration or tick
+ * changes the utilization of @cpu. @util is scaled to SCHED_LOAD_SCALE.
+ */
+typedef void (*sched_util_hook_t)(int cpu, unsigned long util,
+				  unsigned int flags);
+
+extern int sched_register_util_hook(sched_util_hook_t fn);
+extern void sched_unregister_util_hook(sched_util_hook_t fn);
+extern unsigned long sched_cpu_demand(int cpu);
+#endif
+
 extern int task_can_switch_user(struct user_struct *up,
 					struct task_struct *tsk);
 
@@ -503,6 +503,29 @@ static inline struct sk_buff *alloc_skb_fclone(unsigned int size,
 
 extern bool skb_recycle_check(struct sk_buff *skb, int skb_size);
 
+/*
+ * A cache of receive buffers for one device, refilled with skbs the
+ * device is done with instead of freeing them. See skb_pool_alloc().
+ */
+struct sk_buff_pool {
+	struct sk_buff_head	list;		/* ready for reuse */
+	struct sk_buff_head	deferred;	/* given back with irqs off */
+	unsigned int		max_len;	/* 0 disables recycling */
+
+	/* stats */
+	unsigned long		hits;		/* allocations saved */
+	unsigned long		misses;		/* allocations made */
+	unsigned long		recycled;
+	unsigned long		rejected;
+};
+
+extern void skb_pool_init(struct sk_buff_pool *pool, unsigned int max_len);
+extern struct sk_buff *skb_pool_alloc(struct sk_buff_pool *pool,
+				      unsigned int size, gfp_t gfp_mask);
+extern void skb_pool_recycle(struct sk_buff_pool *pool, struct sk_buff *skb,
+			     unsigned int size);
+extern void skb_pool_purge(struct sk_buff_pool *pool);
+
 extern struct sk_buff *skb_morph(struct sk_buff *dst, struct sk_buff *src);
 extern struct sk_buff *skb_clone(struct sk_buff *skb,
 				 gfp_t priority);
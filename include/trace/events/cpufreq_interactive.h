@@ -0,0 +1,76 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cpufreq_interactive
+
+#if !defined(_TRACE_CPUFREQ_INTERACTIVE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_CPUFREQ_INTERACTIVE_H
+
+#include <linux/tracepoint.h>
+
+/**
+ * cpufreq_interactive_sched_ramp - speed raised from a scheduler event
+ * @cpu:	cpu whose utilization changed
+ * @util:	utilization reported by the scheduler, 0..SCHED_LOAD_SCALE
+ * @flags:	SCHED_UTIL_* reason
+ * @old_freq:	previous target frequency
+ * @new_freq:	new target frequency
+ */
+TRACE_EVENT(cpufreq_interactive_sched_ramp,
+
+	TP_PROTO(unsigned int cpu, unsigned long util, unsigned int flags,
+		 unsigned int old_freq, unsigned int new_freq),
+
+	TP_ARGS(cpu, util, flags, old_freq, new_freq),
+
+	TP_STRUCT__entry(
+		__field(	unsigned int,	cpu		)
+		__field(	unsigned long,	util		)
+		__field(	unsigned int,	flags		)
+		__field(	unsigned int,	old_freq	)
+		__field(	unsigned int,	new_freq	)
+	),
+
+	TP_fast_assign(
+		__entry->cpu		= cpu;
+		__entry->util		= util;
+		__entry->flags		= flags;
+		__entry->old_freq	= old_freq;
+		__entry->new_freq	= new_freq;
+	),
+
+	TP_printk("cpu=%u util=%lu flags=%#x old=%u new=%u",
+		  __entry->cpu, __entry->util, __entry->flags,
+		  __entry->old_freq, __entry->new_freq)
+);
+
+/**
+ * cpufreq_interactive_up - up task applied a speed increase
+ * @cpu:	cpu whose target was applied
+ * @target:	requested frequency
+ * @actual:	frequency after the driver call
+ */
+TRACE_EVENT(cpufreq_interactive_up,
+
+	TP_PROTO(unsigned int cpu, unsigned int target, unsigned int actual),
+
+	TP_ARGS(cpu, target, actual),
+
+	TP_STRUCT__entry(
+		__field(	unsigned int,	cpu	)
+		__field(	unsigned int,	target	)
+		__field(	unsigned int,	actual	)
+	),
+
+	TP_fast_assign(
+		__entry->cpu	= cpu;
+		__entry->target	= target;
+		__entry->actual	= actual;
+	),
+
+	TP_printk("cpu=%u target=%u actual=%u",
+		  __entry->cpu, __entry->target, __entry->actual)
+);
+
+#endif /* _TRACE_CPUFREQ_INTERACTIVE_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,51 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM msm_idle
+
+#if !defined(_TRACE_MSM_IDLE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MSM_IDLE_H
+
+#include <linux/tracepoint.h>
+
+/**
+ * msm_idle_exit - one idle period as seen by the idle predictor
+ * @cpu:	cpu that was idle
+ * @sleep_us:	time to the next timer event when idle was entered
+ * @predicted_us: idle length the state choice was based on
+ * @idle_us:	measured idle length
+ * @collapsed:	whether the cpu power collapsed
+ *
+ * A trace of these events can be replayed offline by
+ * tools/power/msm/idle_predict_sim.
+ */
+TRACE_EVENT(msm_idle_exit,
+
+	TP_PROTO(unsigned int cpu, u32 sleep_us, u32 predicted_us,
+		 u32 idle_us, bool collapsed),
+
+	TP_ARGS(cpu, sleep_us, predicted_us, idle_us, collapsed),
+
+	TP_STRUCT__entry(
+		__field(	unsigned int,	cpu		)
+		__field(	u32,		sleep_us	)
+		__field(	u32,		predicted_us	)
+		__field(	u32,		idle_us		)
+		__field(	bool,		collapsed	)
+	),
+
+	TP_fast_assign(
+		__entry->cpu		= cpu;
+		__entry->sleep_us	= sleep_us;
+		__entry->predicted_us	= predicted_us;
+		__entry->idle_us	= idle_us;
+		__entry->collapsed	= collapsed;
+	),
+
+	TP_printk("cpu=%u sleep_us=%u predicted_us=%u idle_us=%u collapsed=%d",
+		  __entry->cpu, __entry->sleep_us, __entry->predicted_us,
+		  __entry->idle_us, __entry->collapsed)
+);
+
+#endif /* _TRACE_MSM_IDLE_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
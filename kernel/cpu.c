@@ -43,6 +43,12 @@ static int cpu_hotplug_disabled;
 
 #ifdef CONFIG_HOTPLUG_CPU
 
+#ifdef CONFIG_HOTPLUG_CPU_PARK
+static DECLARE_BITMAP(cpu_parked_bits, CONFIG_NR_CPUS) __read_mostly;
+const struct cpumask *const cpu_parked_mask = to_cpumask(cpu_parked_bits);
+EXPORT_SYMBOL(cpu_parked_mask);
+#endif
+
 static struct {
 	struct task_struct *active_writer;
 	struct mutex lock; /* Synchronizes accesses to refcount, */
@@ -261,6 +267,11 @@ static int __ref _cpu_down(unsigned int cpu, int tasks_frozen)
 	/* CPU is completely dead: tell everyone.  Too late to complain. */
 	cpu_notify_nofail(CPU_DEAD | mod, hcpu);
 
+#ifdef CONFIG_HOTPLUG_CPU_PARK
+	/* It comes back up unparked */
+	cpumask_clear_cpu(cpu, to_cpumask(cpu_parked_bits));
+#endif
+
 	check_for_tasks(cpu);
 
 out_release:
@@ -288,6 +299,71 @@ out:
 	return err;
 }
 EXPORT_SYMBOL(cpu_down);
+
+#ifdef CONFIG_HOTPLUG_CPU_PARK
+/*
+ * Parking takes a cpu out of cpu_active_mask and the sched domains and
+ * pushes its migratable tasks away, but leaves it online: no notifier
+ * chain, no stop_machine() and no teardown of per-cpu state, so it is
+ * a fraction of the cost of cpu_down(). With nothing to run the cpu
+ * stays in its deepest idle state until unparked.
+ */
+int cpu_park(unsigned int cpu)
+{
+	int err = 0;
+
+	cpu_maps_update_begin();
+
+	if (cpu_hotplug_disabled) {
+		err = -EBUSY;
+		goto out;
+	}
+
+	if (!cpu_online(cpu) || cpu_parked(cpu)) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	if (num_active_cpus() == 1) {
+		err = -EBUSY;
+		goto out;
+	}
+
+	cpu_hotplug_begin();
+	cpumask_set_cpu(cpu, to_cpumask(cpu_parked_bits));
+	err = sched_park_cpu(cpu);
+	if (err)
+		cpumask_clear_cpu(cpu, to_cpumask(cpu_parked_bits));
+	cpu_hotplug_done();
+
+out:
+	cpu_maps_update_done();
+	return err;
+}
+EXPORT_SYMBOL_GPL(cpu_park);
+
+int cpu_unpark(unsigned int cpu)
+{
+	int err = 0;
+
+	cpu_maps_update_begin();
+
+	if (!cpu_online(cpu) || !cpu_parked(cpu)) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	cpu_hotplug_begin();
+	cpumask_clear_cpu(cpu, to_cpumask(cpu_parked_bits));
+	sched_unpark_cpu(cpu);
+	cpu_hotplug_done();
+
+out:
+	cpu_maps_update_done();
+	return err;
+}
+EXPORT_SYMBOL_GPL(cpu_unpark);
+#endif /* CONFIG_HOTPLUG_CPU_PARK */
 #endif /*CONFIG_HOTPLUG_CPU*/
 
 /* Requires cpu_add_remove_lock to be held */
@@ -14,6 +14,59 @@
 
 #include "power.h"
 
+/*
+ * Pages queued for asynchronous I/O to consecutive sectors are collected in
+ * one bio, which is submitted when it is full, when the next page does not
+ * follow it on the device or when the chain it belongs to is waited for.
+ */
+static struct bio *hib_open_bio;
+static int hib_open_rw;
+
+static void hib_end_io(struct bio *bio, int err)
+{
+	const int uptodate = test_bit(BIO_UPTODATE, &bio->bi_flags);
+	struct bio_vec *bvec;
+	int i;
+
+	if (!uptodate)
+		printk(KERN_ALERT "PM: I/O error on image device at %llu\n",
+			(unsigned long long)bio->bi_sector);
+
+	__bio_for_each_segment(bvec, bio, i, 0) {
+		struct page *page = bvec->bv_page;
+
+		if (uptodate) {
+			SetPageUptodate(page);
+		} else {
+			SetPageError(page);
+			ClearPageUptodate(page);
+		}
+		unlock_page(page);
+	}
+	bio_put(bio);
+}
+
+static void hib_submit_open_bio(void)
+{
+	if (!hib_open_bio)
+		return;
+
+	submit_bio(hib_open_rw | REQ_SYNC | REQ_UNPLUG, hib_open_bio);
+	hib_open_bio = NULL;
+}
+
+static struct bio *hib_bio_alloc(struct block_device *bdev, sector_t sector,
+				 int nr_vecs)
+{
+	struct bio *bio;
+
+	bio = bio_alloc(__GFP_WAIT | __GFP_HIGH, nr_vecs);
+	bio->bi_sector = sector;
+	bio->bi_bdev = bdev;
+	bio->bi_end_io = hib_end_io;
+	return bio;
+}
+
 /**
  *	submit - submit BIO request.
  *	@rw:	READ or WRITE.
@@ -21,44 +74,67 @@
  *	@page:	page we're reading or writing.
  *	@bio_chain: list of pending biod (for async reading)
  *
- *	Straight from the textbook - allocate and initialize the bio.
- *	If we're reading, make sure the page is marked as dirty.
- *	Then submit it and, if @bio_chain == NULL, wait.
+ *	If @bio_chain == NULL, allocate a bio for the page, submit it and wait
+ *	for it; if we're reading, make sure the page is marked as dirty.
+ *	Otherwise add the page to the open bio of @bio_chain if it directly
+ *	follows it on the device, or start a new one.
  */
 static int submit(int rw, struct block_device *bdev, sector_t sector,
 		struct page *page, struct bio **bio_chain)
 {
-	const int bio_rw = rw | REQ_SYNC | REQ_UNPLUG;
-	struct bio *bio;
-
-	bio = bio_alloc(__GFP_WAIT | __GFP_HIGH, 1);
-	bio->bi_sector = sector;
-	bio->bi_bdev = bdev;
-	bio->bi_end_io = end_swap_bio_read;
+	struct bio *bio = hib_open_bio;
 
-	if (bio_add_page(bio, page, PAGE_SIZE, 0) < PAGE_SIZE) {
-		printk(KERN_ERR "PM: Adding page to bio failed at %llu\n",
-			(unsigned long long)sector);
-		bio_put(bio);
-		return -EFAULT;
-	}
+	if (bio_chain == NULL) {
+		/* Keep the I/O in the order it was requested in */
+		hib_submit_open_bio();
 
-	lock_page(page);
-	bio_get(bio);
+		bio = hib_bio_alloc(bdev, sector, 1);
+		if (bio_add_page(bio, page, PAGE_SIZE, 0) < PAGE_SIZE) {
+			printk(KERN_ERR "PM: Adding page to bio failed at %llu\n",
+				(unsigned long long)sector);
+			bio_put(bio);
+			return -EFAULT;
+		}
 
-	if (bio_chain == NULL) {
-		submit_bio(bio_rw, bio);
+		lock_page(page);
+		bio_get(bio);
+		submit_bio(rw | REQ_SYNC | REQ_UNPLUG, bio);
 		wait_on_page_locked(page);
 		if (rw == READ)
 			bio_set_pages_dirty(bio);
 		bio_put(bio);
-	} else {
-		if (rw == READ)
-			get_page(page);	/* These pages are freed later */
+		return 0;
+	}
+
+	if (bio && (bio != *bio_chain || hib_open_rw != rw ||
+		    bio->bi_sector + (bio->bi_size >> 9) != sector ||
+		    bio_add_page(bio, page, PAGE_SIZE, 0) < PAGE_SIZE)) {
+		hib_submit_open_bio();
+		bio = NULL;
+	}
+
+	if (!bio) {
+		bio = hib_bio_alloc(bdev, sector, bio_get_nr_vecs(bdev));
+		if (bio_add_page(bio, page, PAGE_SIZE, 0) < PAGE_SIZE) {
+			printk(KERN_ERR "PM: Adding page to bio failed at %llu\n",
+				(unsigned long long)sector);
+			bio_put(bio);
+			return -EFAULT;
+		}
+		bio_get(bio);
 		bio->bi_private = *bio_chain;
 		*bio_chain = bio;
-		submit_bio(bio_rw, bio);
+		hib_open_bio = bio;
+		hib_open_rw = rw;
 	}
+
+	lock_page(page);
+	if (rw == READ)
+		get_page(page);	/* These pages are freed later */
+
+	if (bio->bi_vcnt == bio->bi_max_vecs)
+		hib_submit_open_bio();
+
 	return 0;
 }
 
@@ -86,15 +162,21 @@ int hib_wait_on_bio_chain(struct bio **bio_chain)
 	bio = *bio_chain;
 	if (bio == NULL)
 		return 0;
+	if (bio == hib_open_bio)
+		hib_submit_open_bio();
 	while (bio) {
-		struct page *page;
+		struct bio_vec *bvec;
+		int i;
 
 		next_bio = bio->bi_private;
-		page = bio->bi_io_vec[0].bv_page;
-		wait_on_page_locked(page);
-		if (!PageUptodate(page) || PageError(page))
-			ret = -EIO;
-		put_page(page);
+		__bio_for_each_segment(bvec, bio, i, 0) {
+			struct page *page = bvec->bv_page;
+
+			wait_on_page_locked(page);
+			if (!PageUptodate(page) || PageError(page))
+				ret = -EIO;
+			put_page(page);
+		}
 		bio_put(bio);
 		bio = next_bio;
 	}
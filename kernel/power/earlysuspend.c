@@ -13,7 +13,9 @@
  *
  */
 
+#include <linux/async.h>
 #include <linux/earlysuspend.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
@@ -25,6 +27,7 @@
 enum {
 	DEBUG_USER_STATE = 1U << 0,
 	DEBUG_SUSPEND = 1U << 2,
+	DEBUG_HANDLER_TIME = 1U << 3,
 };
 #ifdef CONFIG_HUAWEI_KERNEL
 static int debug_mask = DEBUG_USER_STATE | DEBUG_SUSPEND;
@@ -33,6 +36,14 @@ static int debug_mask = DEBUG_USER_STATE;
 #endif
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * Run the handlers that share a level concurrently. Levels still run one
+ * after the other, so a handler that depends on another one must use a
+ * later (suspend) level than it.
+ */
+static int async_handlers = 1;
+module_param_named(async, async_handlers, int, S_IRUGO | S_IWUSR | S_IWGRP);
+
 #ifdef CONFIG_HUAWEI_KERNEL
 void set_up_threshold(int screen_on);
 #endif
@@ -41,6 +52,7 @@ void set_up_threshold(int screen_on);
 
 static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
+static LIST_HEAD(early_suspend_domain);
 static void early_suspend(struct work_struct *work);
 static void late_resume(struct work_struct *work);
 static DECLARE_WORK(early_suspend_work, early_suspend);
@@ -79,10 +91,81 @@ void unregister_early_suspend(struct early_suspend *handler)
 }
 EXPORT_SYMBOL(unregister_early_suspend);
 
+static void call_handler(struct early_suspend *handler, bool suspend)
+{
+	void (*fn)(struct early_suspend *h);
+	ktime_t start;
+
+	fn = suspend ? handler->suspend : handler->resume;
+	start = ktime_get();
+	fn(handler);
+#ifdef CONFIG_HUAWEI_KERNEL
+	printk(suspend ? "s: %x\n" : "r: %x\n", (unsigned int)fn);
+#endif
+	if (debug_mask & DEBUG_HANDLER_TIME)
+		pr_info("%s: %pf took %lld us\n",
+			suspend ? "early_suspend" : "late_resume", fn,
+			ktime_to_us(ktime_sub(ktime_get(), start)));
+}
+
+static void async_suspend_handler(void *data, async_cookie_t cookie)
+{
+	call_handler(data, true);
+}
+
+static void async_resume_handler(void *data, async_cookie_t cookie)
+{
+	call_handler(data, false);
+}
+
+/* Does @handler share its level with a neighbour on the sorted list? */
+static bool level_shared(struct early_suspend *handler)
+{
+	struct early_suspend *e;
+
+	if (handler->link.prev != &early_suspend_handlers) {
+		e = list_entry(handler->link.prev, struct early_suspend, link);
+		if (e->level == handler->level)
+			return true;
+	}
+	if (handler->link.next != &early_suspend_handlers) {
+		e = list_entry(handler->link.next, struct early_suspend, link);
+		if (e->level == handler->level)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Calls one handler, in level order. Handlers that share a level with
+ * others are started asynchronously; all of them complete before the
+ * first handler of the next level is called.
+ */
+static void run_handler(struct early_suspend *handler, bool suspend,
+			int *level)
+{
+	if (handler->level != *level) {
+		async_synchronize_full_domain(&early_suspend_domain);
+		*level = handler->level;
+	}
+
+	if (!(suspend ? handler->suspend : handler->resume))
+		return;
+
+	if (async_handlers && level_shared(handler))
+		async_schedule_domain(suspend ? async_suspend_handler :
+				      async_resume_handler,
+				      handler, &early_suspend_domain);
+	else
+		call_handler(handler, suspend);
+}
+
 static void early_suspend(struct work_struct *work)
 {
 	struct early_suspend *pos;
 	unsigned long irqflags;
+	ktime_t start;
+	int level = -1;
 	int abort = 0;
 
 	mutex_lock(&early_suspend_lock);
@@ -102,18 +185,13 @@ static void early_suspend(struct work_struct *work)
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
-	list_for_each_entry(pos, &early_suspend_handlers, link) {
-    /*when early suspend print some log*/
-#ifdef CONFIG_HUAWEI_KERNEL
-        if (pos->suspend != NULL) {
-            pos->suspend(pos);
-            printk("s: %x\n",(unsigned int)pos->suspend);
-        }
-#else
-		if (pos->suspend != NULL)
-			pos->suspend(pos);
-#endif
-	}
+	start = ktime_get();
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		run_handler(pos, true, &level);
+	async_synchronize_full_domain(&early_suspend_domain);
+	if (debug_mask & DEBUG_SUSPEND)
+		pr_info("early_suspend: handlers done in %lld us\n",
+			ktime_to_us(ktime_sub(ktime_get(), start)));
 #ifdef CONFIG_HUAWEI_KERNEL
     /* Set up_threshold to MICRO_FREQUENCY_UP_THRESHOLD when screen is off */
     set_up_threshold(false);
@@ -132,6 +210,8 @@ static void late_resume(struct work_struct *work)
 {
 	struct early_suspend *pos;
 	unsigned long irqflags;
+	ktime_t start;
+	int level = -1;
 	int abort = 0;
 
 	mutex_lock(&early_suspend_lock);
@@ -153,19 +233,13 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
+	start = ktime_get();
 	list_for_each_entry_reverse(pos, &early_suspend_handlers, link)
-    /*when late resume print some log*/    
-#ifdef CONFIG_HUAWEI_KERNEL
-        if (pos->resume != NULL) {
-            pos->resume(pos);
-            printk("r: %x\n",(unsigned int)pos->resume);
-        }
-#else
-		if (pos->resume != NULL)
-			pos->resume(pos);
-#endif
+		run_handler(pos, false, &level);
+	async_synchronize_full_domain(&early_suspend_domain);
 	if (debug_mask & DEBUG_SUSPEND)
-		pr_info("late_resume: done\n");
+		pr_info("late_resume: done in %lld us\n",
+			ktime_to_us(ktime_sub(ktime_get(), start)));
 abort:
 	mutex_unlock(&early_suspend_lock);
 }
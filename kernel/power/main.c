@@ -70,6 +70,35 @@ static ssize_t pm_async_store(struct kobject *kobj, struct kobj_attribute *attr,
 
 power_attr(pm_async);
 
+/* If set, the chain of devices that bounded each device suspend and resume
+ * is logged. */
+int pm_print_critical_path;
+
+static ssize_t pm_print_critical_path_show(struct kobject *kobj,
+					   struct kobj_attribute *attr,
+					   char *buf)
+{
+	return sprintf(buf, "%d\n", pm_print_critical_path);
+}
+
+static ssize_t pm_print_critical_path_store(struct kobject *kobj,
+					    struct kobj_attribute *attr,
+					    const char *buf, size_t n)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 10, &val))
+		return -EINVAL;
+
+	if (val > 1)
+		return -EINVAL;
+
+	pm_print_critical_path = val;
+	return n;
+}
+
+power_attr(pm_print_critical_path);
+
 #ifdef CONFIG_PM_DEBUG
 int pm_test_level = TEST_NONE;
 
@@ -324,6 +353,7 @@ static struct attribute * g[] = {
 #endif
 #ifdef CONFIG_PM_SLEEP
 	&pm_async_attr.attr,
+	&pm_print_critical_path_attr.attr,
 	&wakeup_count_attr.attr,
 #ifdef CONFIG_PM_DEBUG
 	&pm_test_attr.attr,
@@ -21,6 +21,7 @@
 #include <linux/wakelock.h>
 #ifdef CONFIG_WAKELOCK_STAT
 #include <linux/proc_fs.h>
+#include <linux/vmalloc.h>
 #endif
 #include "power.h"
 
@@ -42,7 +43,17 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
 static DEFINE_SPINLOCK(list_lock);
 static LIST_HEAD(inactive_locks);
-static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+
+/*
+ * Active wake locks without a timeout only need to be counted, so they
+ * stay on a list. Those with a timeout are ordered by expiry, which
+ * lets has_wake_lock() find and expire the next one in O(log n) instead
+ * of walking every active lock on each wake_unlock().
+ */
+static struct {
+	struct list_head untimed;
+	struct timerqueue_head timed;
+} active_wake_locks[WAKE_LOCK_TYPE_COUNT];
 static int current_event_num;
 static int suspend_sys_sync_count;
 static DEFINE_SPINLOCK(suspend_sys_sync_lock);
@@ -53,10 +64,56 @@ struct wake_lock main_wake_lock;
 suspend_state_t requested_suspend_state = PM_SUSPEND_MEM;
 static struct wake_lock unknown_wakeup;
 
+static inline struct wake_lock *first_timed_lock(int type)
+{
+	struct timerqueue_node *node;
+
+	node = timerqueue_getnext(&active_wake_locks[type].timed);
+	return node ? container_of(node, struct wake_lock, expires_node) : NULL;
+}
+
+static inline struct wake_lock *next_timed_lock(struct wake_lock *lock)
+{
+	struct timerqueue_node *node;
+
+	node = timerqueue_iterate_next(&lock->expires_node);
+	return node ? container_of(node, struct wake_lock, expires_node) : NULL;
+}
+
+#define for_each_timed_lock(lock, type) \
+	for (lock = first_timed_lock(type); lock; lock = next_timed_lock(lock))
+
+/* Caller must acquire the list_lock spinlock */
+static void wake_lock_unlink(struct wake_lock *lock)
+{
+	int type = lock->flags & WAKE_LOCK_TYPE_MASK;
+
+	if ((lock->flags & (WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE)) ==
+	    (WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE))
+		timerqueue_del(&active_wake_locks[type].timed,
+			       &lock->expires_node);
+	else
+		list_del(&lock->link);
+}
+
 #ifdef CONFIG_WAKELOCK_STAT
 static struct wake_lock deleted_wake_locks;
 static ktime_t last_sleep_time_update;
 static int wait_for_wakeup;
+static int nr_wake_locks;
+static size_t wake_lock_name_bytes;
+
+struct wake_lock_stat_snapshot {
+	const char *name;		/* NULL for a separator */
+	int count;
+	int expire_count;
+	int wakeup_count;
+	ktime_t active_time;
+	ktime_t total_time;
+	ktime_t prevent_suspend_time;
+	ktime_t max_time;
+	ktime_t last_time;
+};
 
 int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 {
@@ -85,7 +142,9 @@ int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 }
 
 
-static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
+/* Caller must acquire the list_lock spinlock */
+static void snapshot_lock_stat(struct wake_lock *lock,
+	struct wake_lock_stat_snapshot *snap, char **names)
 {
 	int lock_count = lock->stat.count;
 	int expire_count = lock->stat.expire_count;
@@ -113,43 +172,104 @@ static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 			max_time = add_time;
 	}
 
+	snap->name = strcpy(*names, lock->name);
+	*names += strlen(lock->name) + 1;
+	snap->count = lock_count;
+	snap->expire_count = expire_count;
+	snap->wakeup_count = lock->stat.wakeup_count;
+	snap->active_time = active_time;
+	snap->total_time = total_time;
+	snap->prevent_suspend_time = prevent_suspend_time;
+	snap->max_time = max_time;
+	snap->last_time = lock->stat.last_time;
+}
+
+static int print_lock_stat(struct seq_file *m,
+	struct wake_lock_stat_snapshot *snap)
+{
+#ifdef CONFIG_HUAWEI_KERNEL
+	if (!snap->name)
+		return seq_printf(m, "!\n!\n!\n");	/* print seperate sign */
+#endif
 	return seq_printf(m,
 		     "\"%s\"\t%d\t%d\t%d\t%lld\t%lld\t%lld\t%lld\t%lld\n",
-		     lock->name, lock_count, expire_count,
-		     lock->stat.wakeup_count, ktime_to_ns(active_time),
-		     ktime_to_ns(total_time),
-		     ktime_to_ns(prevent_suspend_time), ktime_to_ns(max_time),
-		     ktime_to_ns(lock->stat.last_time));
+		     snap->name, snap->count, snap->expire_count,
+		     snap->wakeup_count, ktime_to_ns(snap->active_time),
+		     ktime_to_ns(snap->total_time),
+		     ktime_to_ns(snap->prevent_suspend_time),
+		     ktime_to_ns(snap->max_time),
+		     ktime_to_ns(snap->last_time));
 }
 
+#ifdef CONFIG_HUAWEI_KERNEL
+#define WAKE_LOCK_STAT_SEPARATORS	(WAKE_LOCK_TYPE_COUNT + 1)
+#else
+#define WAKE_LOCK_STAT_SEPARATORS	0
+#endif
+
+static inline void snapshot_separator(struct wake_lock_stat_snapshot **snap)
+{
+#ifdef CONFIG_HUAWEI_KERNEL
+	(*snap)->name = NULL;
+	(*snap)++;
+#endif
+}
+
+/*
+ * The stats are copied out under list_lock and formatted after it is
+ * dropped, so that reading /proc/wakelocks with hundreds of wake locks
+ * does not keep interrupts off for the whole seq_printf() run.
+ */
 static int wakelock_stats_show(struct seq_file *m, void *unused)
 {
+	struct wake_lock_stat_snapshot *snap, *s, *end;
 	unsigned long irqflags;
 	struct wake_lock *lock;
-	int ret;
+	size_t name_bytes;
+	char *names;
+	int nr;
 	int type;
 
-	spin_lock_irqsave(&list_lock, irqflags);
+	for (;;) {
+		spin_lock_irqsave(&list_lock, irqflags);
+		nr = nr_wake_locks + WAKE_LOCK_STAT_SEPARATORS;
+		name_bytes = wake_lock_name_bytes;
+		spin_unlock_irqrestore(&list_lock, irqflags);
+
+		snap = vmalloc(nr * sizeof(*snap) + name_bytes);
+		if (!snap)
+			return -ENOMEM;
+
+		spin_lock_irqsave(&list_lock, irqflags);
+		if (nr_wake_locks + WAKE_LOCK_STAT_SEPARATORS <= nr &&
+		    wake_lock_name_bytes <= name_bytes)
+			break;
+		spin_unlock_irqrestore(&list_lock, irqflags);
+		vfree(snap);
+	}
 
-	ret = seq_puts(m, "name\tcount\texpire_count\twake_count\tactive_since"
-			"\ttotal_time\tsleep_time\tmax_time\tlast_change\n");
+	s = snap;
+	names = (char *)(snap + nr);
 	list_for_each_entry(lock, &inactive_locks, link)
-		ret = print_lock_stat(m, lock);
-
-#ifdef CONFIG_HUAWEI_KERNEL
-    ret = seq_printf(m,"!\n!\n!\n");        /* print seperate sign */
-    for (type = 0; type < WAKE_LOCK_TYPE_COUNT; type++) {
-        list_for_each_entry(lock, &active_wake_locks[type], link)
-            ret = print_lock_stat(m, lock);
-        ret = seq_printf(m,"!\n!\n!\n");    /* print seperate sign */
-    }
-#else
+		snapshot_lock_stat(lock, s++, &names);
+	snapshot_separator(&s);
 	for (type = 0; type < WAKE_LOCK_TYPE_COUNT; type++) {
-		list_for_each_entry(lock, &active_wake_locks[type], link)
-			ret = print_lock_stat(m, lock);
+		list_for_each_entry(lock, &active_wake_locks[type].untimed,
+				    link)
+			snapshot_lock_stat(lock, s++, &names);
+		for_each_timed_lock(lock, type)
+			snapshot_lock_stat(lock, s++, &names);
+		snapshot_separator(&s);
 	}
-#endif
+	end = s;
 	spin_unlock_irqrestore(&list_lock, irqflags);
+
+	seq_puts(m, "name\tcount\texpire_count\twake_count\tactive_since"
+			"\ttotal_time\tsleep_time\tmax_time\tlast_change\n");
+	for (s = snap; s < end; s++)
+		print_lock_stat(m, s);
+
+	vfree(snap);
 	return 0;
 }
 
@@ -179,29 +299,39 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 	}
 }
 
+static void update_sleep_wait_stat_locked(struct wake_lock *lock, int done,
+	ktime_t elapsed)
+{
+	ktime_t etime, add;
+	int expired;
+
+	expired = get_expired_time(lock, &etime);
+	if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
+		if (expired)
+			add = ktime_sub(etime, last_sleep_time_update);
+		else
+			add = elapsed;
+		lock->stat.prevent_suspend_time = ktime_add(
+			lock->stat.prevent_suspend_time, add);
+	}
+	if (done || expired)
+		lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
+	else
+		lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
+}
+
 static void update_sleep_wait_stats_locked(int done)
 {
 	struct wake_lock *lock;
-	ktime_t now, etime, elapsed, add;
-	int expired;
+	ktime_t now, elapsed;
 
 	now = ktime_get();
 	elapsed = ktime_sub(now, last_sleep_time_update);
-	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
-		expired = get_expired_time(lock, &etime);
-		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-			if (expired)
-				add = ktime_sub(etime, last_sleep_time_update);
-			else
-				add = elapsed;
-			lock->stat.prevent_suspend_time = ktime_add(
-				lock->stat.prevent_suspend_time, add);
-		}
-		if (done || expired)
-			lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
-		else
-			lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
-	}
+	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND].untimed,
+			    link)
+		update_sleep_wait_stat_locked(lock, done, elapsed);
+	for_each_timed_lock(lock, WAKE_LOCK_SUSPEND)
+		update_sleep_wait_stat_locked(lock, done, elapsed);
 	last_sleep_time_update = now;
 }
 #endif
@@ -212,8 +342,8 @@ static void expire_wake_lock(struct wake_lock *lock)
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 1);
 #endif
+	wake_lock_unlink(lock);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
 	list_add(&lock->link, &inactive_locks);
 	if (debug_mask & (DEBUG_WAKE_LOCK | DEBUG_EXPIRE))
 		pr_info("expired wake lock %s\n", lock->name);
@@ -226,39 +356,42 @@ static void print_active_locks(int type)
 	bool print_expired = true;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry(lock, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout > 0)
-				pr_info("active wake lock %s, time left %ld\n",
-					lock->name, timeout);
-			else if (print_expired)
-				pr_info("wake lock %s, expired\n", lock->name);
-		} else {
-			pr_info("active wake lock %s\n", lock->name);
-			if (!(debug_mask & DEBUG_EXPIRE))
-				print_expired = false;
-		}
+	list_for_each_entry(lock, &active_wake_locks[type].untimed, link) {
+		pr_info("active wake lock %s\n", lock->name);
+		if (!(debug_mask & DEBUG_EXPIRE))
+			print_expired = false;
+	}
+	for_each_timed_lock(lock, type) {
+		long timeout = lock->expires - jiffies;
+		if (timeout > 0)
+			pr_info("active wake lock %s, time left %ld\n",
+				lock->name, timeout);
+		else if (print_expired)
+			pr_info("wake lock %s, expired\n", lock->name);
 	}
 }
 
+/*
+ * Expires the timed wake locks that are due, earliest first, and returns
+ * -1 if a wake lock without timeout is active, the number of jiffies
+ * until the next timed wake lock expires, or 0.
+ */
 static long has_wake_lock_locked(int type)
 {
-	struct wake_lock *lock, *n;
-	long max_timeout = 0;
+	struct wake_lock *lock;
+	long timeout = 0;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
+	while ((lock = first_timed_lock(type))) {
+		timeout = lock->expires - jiffies;
+		if (timeout > 0)
+			break;
+		expire_wake_lock(lock);
 	}
-	return max_timeout;
+
+	if (!list_empty(&active_wake_locks[type].untimed))
+		return -1;
+	return lock ? timeout : 0;
 }
 
 long has_wake_lock(int type)
@@ -381,6 +514,9 @@ static void suspend(struct work_struct *work)
 }
 static DECLARE_WORK(suspend_work, suspend);
 
+static void expire_wake_locks(unsigned long data);
+static DEFINE_TIMER(expire_timer, expire_wake_locks, 0, 0);
+
 static void expire_wake_locks(unsigned long data)
 {
 	long has_lock;
@@ -395,9 +531,10 @@ static void expire_wake_locks(unsigned long data)
 		pr_info("expire_wake_locks: done, has_lock %ld\n", has_lock);
 	if (has_lock == 0)
 		queue_work(suspend_work_queue, &suspend_work);
+	else if (has_lock > 0)
+		mod_timer(&expire_timer, jiffies + has_lock);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
-static DEFINE_TIMER(expire_timer, expire_wake_locks, 0, 0);
 
 static int power_suspend_late(struct device *dev)
 {
@@ -444,8 +581,13 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 	lock->flags = (type & WAKE_LOCK_TYPE_MASK) | WAKE_LOCK_INITIALIZED;
 
 	INIT_LIST_HEAD(&lock->link);
+	timerqueue_init(&lock->expires_node);
 	spin_lock_irqsave(&list_lock, irqflags);
 	list_add(&lock->link, &inactive_locks);
+#ifdef CONFIG_WAKELOCK_STAT
+	nr_wake_locks++;
+	wake_lock_name_bytes += strlen(lock->name) + 1;
+#endif
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 EXPORT_SYMBOL(wake_lock_init);
@@ -471,8 +613,10 @@ void wake_lock_destroy(struct wake_lock *lock)
 			ktime_add(deleted_wake_locks.stat.max_time,
 				  lock->stat.max_time);
 	}
+	nr_wake_locks--;
+	wake_lock_name_bytes -= strlen(lock->name) + 1;
 #endif
-	list_del(&lock->link);
+	wake_lock_unlink(lock);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 EXPORT_SYMBOL(wake_lock_destroy);
@@ -483,6 +627,7 @@ static void wake_lock_internal(
 	int type;
 	unsigned long irqflags;
 	long expire_in;
+	u64 now;
 
 	spin_lock_irqsave(&list_lock, irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
@@ -501,27 +646,30 @@ static void wake_lock_internal(
 		lock->stat.last_time = ktime_get();
 	}
 #endif
+	wake_lock_unlink(lock);
 	if (!(lock->flags & WAKE_LOCK_ACTIVE)) {
 		lock->flags |= WAKE_LOCK_ACTIVE;
 #ifdef CONFIG_WAKELOCK_STAT
 		lock->stat.last_time = ktime_get();
 #endif
 	}
-	list_del(&lock->link);
 	if (has_timeout) {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d, timeout %ld.%03lu\n",
 				lock->name, type, timeout / HZ,
 				(timeout % HZ) * MSEC_PER_SEC / HZ);
-		lock->expires = jiffies + timeout;
+		now = get_jiffies_64();
+		lock->expires = (unsigned long)now + timeout;
+		lock->expires_node.expires.tv64 = now + timeout;
 		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
-		list_add_tail(&lock->link, &active_wake_locks[type]);
+		timerqueue_add(&active_wake_locks[type].timed,
+			       &lock->expires_node);
 	} else {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d\n", lock->name, type);
 		lock->expires = LONG_MAX;
 		lock->flags &= ~WAKE_LOCK_AUTO_EXPIRE;
-		list_add(&lock->link, &active_wake_locks[type]);
+		list_add(&lock->link, &active_wake_locks[type].untimed);
 	}
 	if (type == WAKE_LOCK_SUSPEND) {
 		current_event_num++;
@@ -575,8 +723,8 @@ void wake_unlock(struct wake_lock *lock)
 #endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
+	wake_lock_unlink(lock);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
 	list_add(&lock->link, &inactive_locks);
 	if (type == WAKE_LOCK_SUSPEND) {
 		long has_lock = has_wake_lock_locked(type);
@@ -629,8 +777,10 @@ static int __init wakelocks_init(void)
 	int ret;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
-		INIT_LIST_HEAD(&active_wake_locks[i]);
+	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++) {
+		INIT_LIST_HEAD(&active_wake_locks[i].untimed);
+		timerqueue_init_head(&active_wake_locks[i].timed);
+	}
 
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
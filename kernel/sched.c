@@ -469,6 +469,17 @@ struct rq {
 	unsigned long nr_load_updates;
 	u64 nr_switches;
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	/* busy time tracking for the cpufreq utilization hook */
+	u64 util_stamp;
+	u64 util_win;
+	u64 util_busy;
+	unsigned long util_avg;
+	unsigned long util_cur;
+	/* sum of se.demand of the queued fair tasks */
+	unsigned long demand;
+#endif
+
 	struct cfs_rq cfs;
 	struct rt_rq rt;
 
@@ -1719,11 +1730,13 @@ static const struct sched_class rt_sched_class;
 static void inc_nr_running(struct rq *rq)
 {
 	rq->nr_running++;
+	sched_update_nr_prod(cpu_of(rq), rq->nr_running);
 }
 
 static void dec_nr_running(struct rq *rq)
 {
 	rq->nr_running--;
+	sched_update_nr_prod(cpu_of(rq), rq->nr_running);
 }
 
 static void set_load_weight(struct task_struct *p)
@@ -2340,7 +2353,9 @@ int select_task_rq(struct rq *rq, struct task_struct *p, int sd_flags, int wake_
 	 *   not worry about this generic constraint ]
 	 */
 	if (unlikely(!cpumask_test_cpu(cpu, &p->cpus_allowed) ||
-		     !cpu_online(cpu)))
+		     !cpu_online(cpu) ||
+		     (cpu_parked(cpu) &&
+		      cpumask_intersects(&p->cpus_allowed, cpu_active_mask))))
 		cpu = select_fallback_rq(task_cpu(p), p);
 
 	return cpu;
@@ -2418,6 +2433,7 @@ static int try_to_wake_up(struct task_struct *p, unsigned int state,
 	int cpu, orig_cpu, this_cpu, success = 0;
 	unsigned long flags;
 	unsigned long en_flags = ENQUEUE_WAKEUP;
+	unsigned int util_flags = 0;
 	struct rq *rq;
 
 	this_cpu = get_cpu();
@@ -2493,10 +2509,15 @@ out_activate:
 	ttwu_activate(p, rq, wake_flags & WF_SYNC, orig_cpu != cpu,
 		      cpu == this_cpu, en_flags);
 	success = 1;
+	util_flags = orig_cpu != cpu ? SCHED_UTIL_MIGRATE : SCHED_UTIL_WAKEUP;
 out_running:
 	ttwu_post_activation(p, rq, wake_flags, success);
 out:
 	task_rq_unlock(rq, &flags);
+	if (util_flags)
+		sched_util_notify(cpu, util_flags);
+	if (util_flags & SCHED_UTIL_MIGRATE)
+		sched_util_notify(orig_cpu, SCHED_UTIL_MIGRATE_OUT);
 	put_cpu();
 
 	return success;
@@ -2568,6 +2589,12 @@ static void __sched_fork(struct task_struct *p)
 	p->se.prev_sum_exec_runtime	= 0;
 	p->se.nr_migrations		= 0;
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	p->se.demand_win_start		= 0;
+	p->se.demand_runtime		= 0;
+	p->se.demand			= 0;
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
@@ -2699,6 +2726,7 @@ void wake_up_new_task(struct task_struct *p, unsigned long clone_flags)
 		p->sched_class->task_woken(rq, p);
 #endif
 	task_rq_unlock(rq, &flags);
+	sched_util_notify(cpu_of(rq), SCHED_UTIL_WAKEUP);
 	put_cpu();
 }
 
@@ -3782,6 +3810,9 @@ void scheduler_tick(void)
 	curr->sched_class->task_tick(rq, curr, 0);
 	raw_spin_unlock(&rq->lock);
 
+	if (curr != rq->idle)
+		sched_util_notify(cpu, SCHED_UTIL_TICK);
+
 	perf_event_task_tick();
 
 #ifdef CONFIG_SMP
@@ -5888,6 +5919,58 @@ static void migrate_tasks(unsigned int dead_cpu)
 	rq->stop = stop;
 }
 
+#ifdef CONFIG_HOTPLUG_CPU_PARK
+/*
+ * Runs on the cpu being parked, from its stopper thread, so nothing
+ * else runs there while its queued tasks are pushed to active cpus.
+ * Tasks that may only run on this cpu (its per-cpu kthreads) stay.
+ */
+static int park_cpu_stop(void *data)
+{
+	unsigned int cpu = smp_processor_id();
+	struct task_struct *g, *p;
+	int dest_cpu;
+
+	local_irq_disable();
+	read_lock(&tasklist_lock);
+	do_each_thread(g, p) {
+		if (p == current || !p->se.on_rq || task_cpu(p) != cpu)
+			continue;
+
+		dest_cpu = cpumask_any_and(&p->cpus_allowed, cpu_active_mask);
+		if (dest_cpu < nr_cpu_ids)
+			__migrate_task(p, cpu, dest_cpu);
+	} while_each_thread(g, p);
+	read_unlock(&tasklist_lock);
+	local_irq_enable();
+
+	return 0;
+}
+
+/*
+ * Called from cpu_park() with the hotplug lock held. Sleeping tasks are
+ * moved by select_task_rq() when they next wake.
+ */
+void sched_unpark_cpu(int cpu)
+{
+	set_cpu_active(cpu, true);
+	cpuset_update_active_cpus();
+}
+
+int sched_park_cpu(int cpu)
+{
+	int err;
+
+	set_cpu_active(cpu, false);
+	cpuset_update_active_cpus();
+
+	err = stop_one_cpu(cpu, park_cpu_stop, NULL);
+	if (err)
+		sched_unpark_cpu(cpu);
+	return err;
+}
+#endif /* CONFIG_HOTPLUG_CPU_PARK */
+
 #endif /* CONFIG_HOTPLUG_CPU */
 
 #if defined(CONFIG_SCHED_DEBUG) && defined(CONFIG_SYSCTL)
@@ -6150,7 +6233,9 @@ static int __cpuinit sched_cpu_active(struct notifier_block *nfb,
 	switch (action & ~CPU_TASKS_FROZEN) {
 	case CPU_ONLINE:
 	case CPU_DOWN_FAILED:
-		set_cpu_active((long)hcpu, true);
+		/* A parked cpu that failed to go down stays parked */
+		if (!cpu_parked((long)hcpu))
+			set_cpu_active((long)hcpu, true);
 		return NOTIFY_OK;
 	default:
 		return NOTIFY_DONE;
@@ -0,0 +1,91 @@
+/*
+ * kernel/sched_avg.c
+ *
+ * Time weighted average of the number of runnable tasks, for consumers
+ * such as cpu hotplug governors that would otherwise poll nr_running().
+ *
+ * Each cpu keeps the integral of its rq->nr_running over sched_clock()
+ * time, updated under rq->lock whenever nr_running changes. Consumers
+ * keep their own snapshot of the summed integral, so any number of them
+ * can sample at their own rate.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/math64.h>
+
+struct nr_avg_cpu {
+	spinlock_t lock;
+	unsigned long nr;	/* nr_running since last_time */
+	u64 last_time;
+	u64 prod_sum;		/* integral of nr over time, in task*ns */
+};
+
+static DEFINE_PER_CPU(struct nr_avg_cpu, nr_avg_cpu) = {
+	.lock = __SPIN_LOCK_UNLOCKED(nr_avg_cpu.lock),
+};
+
+static void nr_avg_fold(struct nr_avg_cpu *n, u64 now)
+{
+	if (now > n->last_time)
+		n->prod_sum += n->nr * (now - n->last_time);
+	n->last_time = now;
+}
+
+/*
+ * Called with rq->lock held after @cpu's nr_running changed to
+ * @nr_running.
+ */
+void sched_update_nr_prod(int cpu, unsigned long nr_running)
+{
+	struct nr_avg_cpu *n = &per_cpu(nr_avg_cpu, cpu);
+
+	spin_lock(&n->lock);
+	nr_avg_fold(n, sched_clock());
+	n->nr = nr_running;
+	spin_unlock(&n->lock);
+}
+
+/**
+ * sched_get_nr_running_avg - average nr_running since the last call
+ * @s: caller's sampling state, zero initialised before the first call
+ *
+ * Returns the system-wide number of runnable tasks averaged over the
+ * time since the previous call with @s, scaled by 100, or 0 on the
+ * first call.
+ */
+unsigned int sched_get_nr_running_avg(struct sched_nr_avg *s)
+{
+	u64 now = sched_clock();
+	u64 sum = 0;
+	u64 delta;
+	unsigned int avg = 0;
+	unsigned long flags;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct nr_avg_cpu *n = &per_cpu(nr_avg_cpu, cpu);
+
+		spin_lock_irqsave(&n->lock, flags);
+		nr_avg_fold(n, now);
+		sum += n->prod_sum;
+		spin_unlock_irqrestore(&n->lock, flags);
+	}
+
+	if (s->time && now > s->time) {
+		delta = now - s->time;
+		avg = div64_u64((sum - s->sum) * 100, delta);
+	}
+
+	s->time = now;
+	s->sum = sum;
+
+	return avg;
+}
+EXPORT_SYMBOL_GPL(sched_get_nr_running_avg);
@@ -89,6 +89,15 @@ unsigned int normalized_sysctl_sched_wakeup_granularity = 1000000UL;
 
 const_debug unsigned int sysctl_sched_migration_cost = 500000UL;
 
+/*
+ * Small task packing (see the PACK_SMALL_TASKS feature): a waking task
+ * whose demand is below sysctl_sched_small_task_pct percent is placed
+ * on a cpu that is already running, as long as that cpu stays below
+ * sysctl_sched_pack_util_pct percent utilization with the task added.
+ */
+const_debug unsigned int sysctl_sched_small_task_pct = 20;
+const_debug unsigned int sysctl_sched_pack_util_pct = 80;
+
 /*
  * The exponential sliding  window over which load is averaged for shares
  * distribution.
@@ -567,6 +576,70 @@ __update_curr(struct cfs_rq *cfs_rq, struct sched_entity *curr,
 #endif
 }
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+#define SCHED_UTIL_WINDOW	(10 * NSEC_PER_MSEC)
+
+/*
+ * Per-task demand: the fraction of a SCHED_UTIL_WINDOW the task spends
+ * running, averaged with its history. A window in which the task slept
+ * throughout only counts as one window, so demand describes how busy
+ * the task keeps a cpu while it is active rather than how often it
+ * wakes. The demand of queued tasks is summed in rq->demand, which moves
+ * with the task on dequeue/enqueue when it migrates.
+ */
+static void update_task_demand(struct rq *rq, struct sched_entity *se,
+			       unsigned long delta_exec)
+{
+	u64 now = rq->clock_task;
+	unsigned long old = se->demand;
+	unsigned long frac;
+	u64 elapsed;
+
+	se->demand_runtime += delta_exec;
+
+	/* rq clocks are not synchronized across cpus */
+	if ((s64)(now - se->demand_win_start) < 0)
+		se->demand_win_start = now;
+
+	elapsed = now - se->demand_win_start;
+	if (elapsed < SCHED_UTIL_WINDOW)
+		return;
+	if (elapsed >= 2 * SCHED_UTIL_WINDOW)
+		elapsed = SCHED_UTIL_WINDOW;
+
+	frac = min_t(u64, div_u64(se->demand_runtime << SCHED_LOAD_SHIFT,
+				  (u32)elapsed), SCHED_LOAD_SCALE);
+	se->demand = (se->demand + frac) >> 1;
+	se->demand_win_start = now;
+	se->demand_runtime = 0;
+
+	if (se->on_rq)
+		rq->demand = rq->demand - old + se->demand;
+}
+
+static inline void inc_rq_demand(struct rq *rq, struct sched_entity *se)
+{
+	rq->demand += se->demand;
+}
+
+static inline void dec_rq_demand(struct rq *rq, struct sched_entity *se)
+{
+	rq->demand -= min(rq->demand, se->demand);
+}
+
+unsigned long sched_cpu_demand(int cpu)
+{
+	return min_t(unsigned long, ACCESS_ONCE(cpu_rq(cpu)->demand),
+		     SCHED_LOAD_SCALE);
+}
+EXPORT_SYMBOL_GPL(sched_cpu_demand);
+#else
+static inline void update_task_demand(struct rq *rq, struct sched_entity *se,
+				      unsigned long delta_exec) {}
+static inline void inc_rq_demand(struct rq *rq, struct sched_entity *se) {}
+static inline void dec_rq_demand(struct rq *rq, struct sched_entity *se) {}
+#endif
+
 static void update_curr(struct cfs_rq *cfs_rq)
 {
 	struct sched_entity *curr = cfs_rq->curr;
@@ -594,6 +667,7 @@ static void update_curr(struct cfs_rq *cfs_rq)
 		trace_sched_stat_runtime(curtask, delta_exec, curr->vruntime);
 		cpuacct_charge(curtask, delta_exec);
 		account_group_exec_runtime(curtask, delta_exec);
+		update_task_demand(rq_of(cfs_rq), curr, delta_exec);
 	}
 }
 
@@ -1263,6 +1337,100 @@ static inline void hrtick_update(struct rq *rq)
 }
 #endif
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+/*
+ * Runqueue utilization for cpufreq: the busy fraction of each
+ * SCHED_UTIL_WINDOW, averaged with the previous windows so that a
+ * single busy window ramps halfway. Updated on enqueue, dequeue and
+ * tick, under rq->lock.
+ */
+static sched_util_hook_t sched_util_hook;
+
+static void update_rq_util(struct rq *rq)
+{
+	int busy = rq->curr != rq->idle;
+	u64 delta, step;
+
+	if (rq->clock_task <= rq->util_stamp)
+		return;
+
+	delta = rq->clock_task - rq->util_stamp;
+	rq->util_stamp = rq->clock_task;
+
+	while (delta) {
+		step = min_t(u64, delta, SCHED_UTIL_WINDOW - rq->util_win);
+		if (busy)
+			rq->util_busy += step;
+		rq->util_win += step;
+		delta -= step;
+
+		if (rq->util_win < SCHED_UTIL_WINDOW)
+			break;
+
+		rq->util_avg = (rq->util_avg +
+				div_u64(rq->util_busy << SCHED_LOAD_SHIFT,
+					SCHED_UTIL_WINDOW)) >> 1;
+		rq->util_win = 0;
+		rq->util_busy = 0;
+
+		/* Idle long enough for the history to have decayed away */
+		if (!busy && delta >= 8 * SCHED_UTIL_WINDOW) {
+			rq->util_avg = 0;
+			break;
+		}
+	}
+
+	rq->util_cur = rq->util_avg;
+	if (rq->util_win >= SCHED_UTIL_WINDOW / 2)
+		rq->util_cur = max_t(unsigned long, rq->util_cur,
+				     div_u64(rq->util_busy << SCHED_LOAD_SHIFT,
+					     (u32)rq->util_win));
+}
+
+/*
+ * Tell the hook about the utilization of @cpu: its own busy history or
+ * the demand of the tasks queued on it, whichever is higher, so a task
+ * that just migrated in is accounted at once. More than one runnable
+ * fair task means the cpu is saturated whatever its recent history.
+ * Must be called without rq->lock held.
+ */
+static void sched_util_notify(int cpu, unsigned int flags)
+{
+	struct rq *rq = cpu_rq(cpu);
+	sched_util_hook_t fn;
+	unsigned long util;
+
+	rcu_read_lock_sched();
+	fn = rcu_dereference_sched(sched_util_hook);
+	if (fn) {
+		util = max(ACCESS_ONCE(rq->util_cur),
+			   ACCESS_ONCE(rq->demand));
+		if (rq->cfs.nr_running > 1)
+			util = SCHED_LOAD_SCALE;
+		fn(cpu, min_t(unsigned long, util, SCHED_LOAD_SCALE), flags);
+	}
+	rcu_read_unlock_sched();
+}
+
+int sched_register_util_hook(sched_util_hook_t fn)
+{
+	if (cmpxchg(&sched_util_hook, NULL, fn))
+		return -EBUSY;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(sched_register_util_hook);
+
+void sched_unregister_util_hook(sched_util_hook_t fn)
+{
+	if (cmpxchg(&sched_util_hook, fn, NULL) == fn)
+		synchronize_sched();
+}
+EXPORT_SYMBOL_GPL(sched_unregister_util_hook);
+#else
+static inline void update_rq_util(struct rq *rq) {}
+static inline void sched_util_notify(int cpu, unsigned int flags) {}
+#endif
+
 /*
  * The enqueue_task method is called before nr_running is
  * increased. Here we update the fair scheduling stats and
@@ -1274,6 +1442,8 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct cfs_rq *cfs_rq;
 	struct sched_entity *se = &p->se;
 
+	update_rq_util(rq);
+
 	for_each_sched_entity(se) {
 		if (se->on_rq)
 			break;
@@ -1289,6 +1459,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 		update_cfs_shares(cfs_rq, 0);
 	}
 
+	inc_rq_demand(rq, &p->se);
 	hrtick_update(rq);
 }
 
@@ -1302,6 +1473,8 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct cfs_rq *cfs_rq;
 	struct sched_entity *se = &p->se;
 
+	update_rq_util(rq);
+
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		dequeue_entity(cfs_rq, se, flags);
@@ -1319,6 +1492,7 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 		update_cfs_shares(cfs_rq, 0);
 	}
 
+	dec_rq_demand(rq, &p->se);
 	hrtick_update(rq);
 }
 
@@ -1643,6 +1817,67 @@ static int select_idle_sibling(struct task_struct *p, int target)
 	return target;
 }
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+static inline unsigned long pack_cpu_util(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+
+	return max(ACCESS_ONCE(rq->util_cur), ACCESS_ONCE(rq->demand));
+}
+
+static inline int pack_fits(int cpu, unsigned long demand)
+{
+	return !idle_cpu(cpu) && cpu_active(cpu) &&
+		(pack_cpu_util(cpu) + demand) * 100 <
+		(sysctl_sched_pack_util_pct << SCHED_LOAD_SHIFT);
+}
+
+/*
+ * Spreading a short task to an idle core means taking that core out of
+ * power collapse only for it to go back in a moment later. If the task
+ * is small, keep it on a core that is awake anyway: prev_cpu or this cpu
+ * when they have room for it (cache), else the busiest running core
+ * that still does.
+ *
+ * Returns -1 when the task is not small or no running core has room.
+ */
+static int select_packing_cpu(struct task_struct *p, int cpu, int prev_cpu)
+{
+	unsigned long demand = p->se.demand;
+	unsigned long util, best_util = 0;
+	int i, best = -1;
+
+	if (demand * 100 >= (sysctl_sched_small_task_pct << SCHED_LOAD_SHIFT))
+		return -1;
+
+	if (cpumask_test_cpu(prev_cpu, &p->cpus_allowed) &&
+	    pack_fits(prev_cpu, demand))
+		return prev_cpu;
+
+	if (cpumask_test_cpu(cpu, &p->cpus_allowed) && pack_fits(cpu, demand))
+		return cpu;
+
+	for_each_cpu_and(i, &p->cpus_allowed, cpu_active_mask) {
+		if (i == cpu || i == prev_cpu || !pack_fits(i, demand))
+			continue;
+
+		util = pack_cpu_util(i);
+		if (best < 0 || util > best_util) {
+			best_util = util;
+			best = i;
+		}
+	}
+
+	return best;
+}
+#else
+static inline int
+select_packing_cpu(struct task_struct *p, int cpu, int prev_cpu)
+{
+	return -1;
+}
+#endif
+
 /*
  * sched_balance_self: balance the current task (running on cpu) in domains
  * that have the 'flag' flag set. In practice, this is SD_BALANCE_FORK and
@@ -1666,6 +1901,14 @@ select_task_rq_fair(struct rq *rq, struct task_struct *p, int sd_flag, int wake_
 	int sync = wake_flags & WF_SYNC;
 
 	if (sd_flag & SD_BALANCE_WAKE) {
+		if (sched_feat(PACK_SMALL_TASKS)) {
+			new_cpu = select_packing_cpu(p, cpu, prev_cpu);
+			if (new_cpu >= 0) {
+				schedstat_inc(p, se.statistics.nr_wakeups_packed);
+				return new_cpu;
+			}
+		}
+
 		if (cpumask_test_cpu(cpu, &p->cpus_allowed))
 			want_affine = 1;
 		new_cpu = prev_cpu;
@@ -3305,6 +3548,12 @@ redo:
 		double_rq_unlock(this_rq, busiest);
 		local_irq_restore(flags);
 
+		if (ld_moved) {
+			sched_util_notify(this_cpu, SCHED_UTIL_MIGRATE);
+			sched_util_notify(cpu_of(busiest),
+					  SCHED_UTIL_MIGRATE_OUT);
+		}
+
 		/*
 		 * some other cpu did the load balance for us.
 		 */
@@ -4031,6 +4280,8 @@ static void task_tick_fair(struct rq *rq, struct task_struct *curr, int queued)
 		cfs_rq = cfs_rq_of(se);
 		entity_tick(cfs_rq, se, queued);
 	}
+
+	update_rq_util(rq);
 }
 
 /*
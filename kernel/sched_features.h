@@ -64,3 +64,9 @@ SCHED_FEAT(OWNER_SPIN, 1)
  * Decrement CPU power based on irq activity
  */
 SCHED_FEAT(NONIRQ_POWER, 1)
+
+/*
+ * Wake small tasks on an already running cpu instead of an idle one,
+ * see sysctl_sched_small_task_pct and sysctl_sched_pack_util_pct.
+ */
+SCHED_FEAT(PACK_SMALL_TASKS, 1)
@@ -126,6 +126,7 @@
 #include <linux/ipv6.h>
 #include <linux/in.h>
 #include <linux/jhash.h>
+#include <linux/math64.h>
 #include <linux/random.h>
 #include <trace/events/napi.h>
 #include <trace/events/net.h>
@@ -2544,6 +2545,67 @@ EXPORT_SYMBOL(__skb_get_rxhash);
 struct rps_sock_flow_table __rcu *rps_sock_flow_table __read_mostly;
 EXPORT_SYMBOL(rps_sock_flow_table);
 
+/*
+ * Adaptive steering: a CPU whose NET_RX softirq has been busy for more
+ * than rps_adaptive_thresh percent of the last window spreads the
+ * packets of queues without an RPS map over the online CPUs. It stops
+ * once its load falls below half the threshold, but not within a second
+ * of last being over it, so that flows are not bounced between queues.
+ * Zero disables it.
+ */
+int rps_adaptive_thresh __read_mostly;
+
+#define RPS_ADAPTIVE_WINDOW	(100 * NSEC_PER_MSEC)
+
+/* Called by net_rx_action with the time it started at */
+static void rps_adaptive_update(struct softnet_data *sd, u64 start)
+{
+	u64 now = local_clock();
+	u64 elapsed;
+	unsigned int load;
+
+	sd->rx_busy += now - start;
+	elapsed = now - sd->rx_window_start;
+	if (elapsed < RPS_ADAPTIVE_WINDOW)
+		return;
+
+	load = div64_u64(sd->rx_busy * 100, elapsed);
+	sd->rx_window_start = now;
+	sd->rx_busy = 0;
+
+	if (load >= rps_adaptive_thresh) {
+		sd->rps_adaptive = true;
+		sd->rps_adaptive_until = jiffies + HZ;
+	} else if (load < rps_adaptive_thresh / 2 &&
+		   time_after(jiffies, sd->rps_adaptive_until)) {
+		sd->rps_adaptive = false;
+	}
+}
+
+/*
+ * Pick an online CPU by flow hash for a queue without an RPS map, if
+ * this CPU is steering. The online mask is read per packet, so CPUs
+ * that are unplugged or brought up take part right away.
+ */
+static int get_rps_adaptive_cpu(struct sk_buff *skb)
+{
+	unsigned int idx;
+	int cpu;
+
+	if (!rps_adaptive_thresh || !__get_cpu_var(softnet_data).rps_adaptive)
+		return -1;
+
+	skb_reset_network_header(skb);
+	if (!skb_get_rxhash(skb))
+		return -1;
+
+	idx = ((u64) skb->rxhash * num_online_cpus()) >> 32;
+	for_each_online_cpu(cpu)
+		if (idx-- == 0)
+			return cpu;
+	return -1;
+}
+
 /*
  * get_rps_cpu is called from netif_receive_skb and returns the target
  * CPU from the RPS map of the receiving queue for a given skb.
@@ -2582,6 +2644,7 @@ static int get_rps_cpu(struct net_device *dev, struct sk_buff *skb,
 			goto done;
 		}
 	} else if (!rcu_dereference_raw(rxqueue->rps_flow_table)) {
+		cpu = get_rps_adaptive_cpu(skb);
 		goto done;
 	}
 
@@ -3373,11 +3436,23 @@ __napi_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 
 	for (p = napi->gro_list; p; p = p->next) {
 		unsigned long diffs;
+		unsigned int maclen;
 
 		diffs = (unsigned long)p->dev ^ (unsigned long)skb->dev;
 		diffs |= p->vlan_tci ^ skb->vlan_tci;
-		diffs |= compare_ether_header(skb_mac_header(p),
-					      skb_gro_mac_header(skb));
+
+		/*
+		 * Only the link header the device has is compared, raw-IP
+		 * devices such as rmnet have none and the flow is then
+		 * told apart by the protocol gro_receive handlers alone.
+		 */
+		maclen = skb->dev->hard_header_len;
+		if (maclen == ETH_HLEN)
+			diffs |= compare_ether_header(skb_mac_header(p),
+						      skb_gro_mac_header(skb));
+		else if (!diffs)
+			diffs = memcmp(skb_mac_header(p),
+				       skb_gro_mac_header(skb), maclen);
 		NAPI_GRO_CB(p)->same_flow = !diffs;
 		NAPI_GRO_CB(p)->flush = 0;
 	}
@@ -3703,6 +3778,9 @@ static void net_rx_action(struct softirq_action *h)
 	unsigned long time_limit = jiffies + 2;
 	int budget = netdev_budget;
 	void *have;
+#ifdef CONFIG_RPS
+	u64 start = rps_adaptive_thresh ? local_clock() : 0;
+#endif
 
 	local_irq_disable();
 
@@ -3767,6 +3845,11 @@ static void net_rx_action(struct softirq_action *h)
 out:
 	net_rps_action_and_irq_enable(sd);
 
+#ifdef CONFIG_RPS
+	if (start)
+		rps_adaptive_update(sd, start);
+#endif
+
 #ifdef CONFIG_NET_DMA
 	/*
 	 * There may not be any more sk_buffs coming right now, so push
@@ -504,6 +504,99 @@ bool skb_recycle_check(struct sk_buff *skb, int skb_size)
 }
 EXPORT_SYMBOL(skb_recycle_check);
 
+/**
+ *	skb_pool_init - set up a receive buffer pool
+ *	@pool: pool to initialise
+ *	@max_len: number of buffers kept for reuse, 0 disables recycling
+ */
+void skb_pool_init(struct sk_buff_pool *pool, unsigned int max_len)
+{
+	skb_queue_head_init(&pool->list);
+	skb_queue_head_init(&pool->deferred);
+	pool->max_len = max_len;
+	pool->hits = 0;
+	pool->misses = 0;
+	pool->recycled = 0;
+	pool->rejected = 0;
+}
+EXPORT_SYMBOL(skb_pool_init);
+
+/**
+ *	skb_pool_alloc - allocate an skbuff for receiving from a pool
+ *	@pool: pool to take the buffer from
+ *	@size: length to allocate
+ *	@gfp_mask: allocation mask, used when the pool is empty
+ *
+ *	Returns a buffer laid out as by __dev_alloc_skb(@size), reused
+ *	from @pool when one large enough is available.
+ */
+struct sk_buff *skb_pool_alloc(struct sk_buff_pool *pool, unsigned int size,
+			       gfp_t gfp_mask)
+{
+	struct sk_buff *skb;
+
+	if (!irqs_disabled())
+		while ((skb = skb_dequeue(&pool->deferred)) != NULL)
+			skb_pool_recycle(pool, skb, size);
+
+	/* buffers recycled before a size change may be too small */
+	while ((skb = skb_dequeue(&pool->list)) != NULL) {
+		if (skb_end_pointer(skb) - skb->head >=
+		    SKB_DATA_ALIGN(size + NET_SKB_PAD)) {
+			pool->hits++;
+			return skb;
+		}
+		kfree_skb(skb);
+	}
+
+	pool->misses++;
+	return __dev_alloc_skb(size, gfp_mask);
+}
+EXPORT_SYMBOL(skb_pool_alloc);
+
+/**
+ *	skb_pool_recycle - give a buffer back to a pool
+ *	@pool: pool to refill
+ *	@skb: buffer the caller is done with
+ *	@size: length the pool currently allocates
+ *
+ *	Keeps @skb for skb_pool_alloc() if skb_recycle_check() accepts it
+ *	and the pool is not full, frees it otherwise. With interrupts
+ *	disabled the check cannot be made, so buffers without a destructor
+ *	are set aside until the next allocation.
+ */
+void skb_pool_recycle(struct sk_buff_pool *pool, struct sk_buff *skb,
+		      unsigned int size)
+{
+	if (irqs_disabled()) {
+		if (!skb->destructor &&
+		    skb_queue_len(&pool->deferred) < pool->max_len) {
+			skb_queue_tail(&pool->deferred, skb);
+			return;
+		}
+	} else if (skb_queue_len(&pool->list) < pool->max_len &&
+		   skb_recycle_check(skb, size)) {
+		skb_queue_tail(&pool->list, skb);
+		pool->recycled++;
+		return;
+	}
+
+	pool->rejected++;
+	dev_kfree_skb_any(skb);
+}
+EXPORT_SYMBOL(skb_pool_recycle);
+
+/**
+ *	skb_pool_purge - free all buffers held by a pool
+ *	@pool: pool to empty
+ */
+void skb_pool_purge(struct sk_buff_pool *pool)
+{
+	skb_queue_purge(&pool->deferred);
+	skb_queue_purge(&pool->list);
+}
+EXPORT_SYMBOL(skb_pool_purge);
+
 static void __copy_skb_header(struct sk_buff *new, const struct sk_buff *old)
 {
 	new->tstamp		= old->tstamp;
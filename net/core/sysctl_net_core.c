@@ -76,6 +76,9 @@ static int rps_sock_flow_sysctl(ctl_table *table, int write,
 
 	return ret;
 }
+
+static int zero;
+static int one_hundred = 100;
 #endif /* CONFIG_RPS */
 
 static struct ctl_table net_core_table[] = {
@@ -157,6 +160,15 @@ static struct ctl_table net_core_table[] = {
 		.mode		= 0644,
 		.proc_handler	= rps_sock_flow_sysctl
 	},
+	{
+		.procname	= "rps_adaptive_thresh",
+		.data		= &rps_adaptive_thresh,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one_hundred,
+	},
 #endif
 #endif /* CONFIG_NET */
 	{
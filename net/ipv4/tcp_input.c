@@ -366,6 +366,10 @@ static void tcp_init_buffer_space(struct sock *sk)
 		tcp_fixup_sndbuf(sk);
 
 	tp->rcvq_space.space = tp->rcv_wnd;
+	/* Let the first measurement of the BDP mode see slow start */
+	if (sysctl_tcp_moderate_rcvbuf > 1)
+		tp->rcvq_space.space = min_t(u32, tp->rcv_wnd,
+					     10 * tp->advmss);
 
 	maxwin = tcp_full_space(sk);
 
@@ -494,6 +498,49 @@ static inline void tcp_rcv_rtt_measure_ts(struct sock *sk,
 		tcp_rcv_rtt_update(tp, tcp_time_stamp - tp->rx_opt.rcv_tsecr, 0);
 }
 
+/*
+ * tcp_moderate_rcvbuf = 2. What the application read over the last
+ * receive RTT is the in-order delivery rate times the RTT, the BDP of
+ * the path as far as this receiver can tell. Size the window to twice
+ * that, so the sender is not window limited while it doubles in slow
+ * start, and when the rate grew since the last RTT assume it keeps
+ * growing at that pace. This reaches full rate on long, fat cellular
+ * paths within a few RTTs, where following the last measurement alone
+ * takes one round per doubling and more.
+ */
+static void tcp_rcv_space_adjust_bdp(struct sock *sk, u32 copied)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	u32 space = tp->rcvq_space.space;
+	u64 rcvwin, grow;
+	int rcvmem, rcvbuf;
+
+	if (copied <= space)
+		return;
+	tp->rcvq_space.space = copied;
+
+	if ((sk->sk_userlocks & SOCK_RCVBUF_LOCK) || !space)
+		return;
+
+	rcvwin = ((u64)copied << 1) + 16 * tp->advmss;
+	grow = rcvwin * (copied - space);
+	do_div(grow, space);
+	rcvwin += grow << 1;
+
+	rcvmem = tp->advmss + MAX_TCP_HEADER + 16 + sizeof(struct sk_buff);
+	while (tcp_win_from_space(rcvmem) < tp->advmss)
+		rcvmem += 128;
+
+	do_div(rcvwin, tp->advmss);
+	rcvbuf = min_t(u64, rcvwin * rcvmem, sysctl_tcp_rmem[2]);
+	if (rcvbuf > sk->sk_rcvbuf) {
+		sk->sk_rcvbuf = rcvbuf;
+
+		/* Make the window clamp follow along.  */
+		tp->window_clamp = tcp_win_from_space(rcvbuf);
+	}
+}
+
 /*
  * This function should be called every time data is copied to user space.
  * It calculates the appropriate TCP receive buffer space.
@@ -511,6 +558,12 @@ void tcp_rcv_space_adjust(struct sock *sk)
 	if (time < (tp->rcv_rtt_est.rtt >> 3) || tp->rcv_rtt_est.rtt == 0)
 		return;
 
+	if (sysctl_tcp_moderate_rcvbuf > 1) {
+		tcp_rcv_space_adjust_bdp(sk, tp->copied_seq -
+					     tp->rcvq_space.seq);
+		goto new_measure;
+	}
+
 	space = 2 * (tp->copied_seq - tp->rcvq_space.seq);
 
 	space = max(tp->rcvq_space.space, space);
@@ -0,0 +1,237 @@
+/*
+ * TCP MinRTT: bounded queueing delay congestion control
+ *
+ * Cellular basestations keep seconds worth of buffer per user. Loss
+ * based algorithms such as Reno or CUBIC only back off once that buffer
+ * overflows, so every interactive packet sharing the link waits behind
+ * it. MinRTT instead keeps the queue it builds below target_delay:
+ *
+ *  o the propagation delay is the minimum RTT seen over the last
+ *    min_rtt_win seconds
+ *  o the delivery rate is measured once per round trip, from the
+ *    packets acked during it, and the largest rate of the last
+ *    MINRTT_BW_ROUNDS rounds is kept
+ *  o while the smallest RTT of a round stays within target_delay of
+ *    the minimum, cwnd grows as in Reno, so more bandwidth is found
+ *  o once it does not, cwnd is cut to the delivery rate times
+ *    (min RTT + target_delay) and slow start ends
+ *
+ * Loss still halves cwnd, but not below the rate based window.
+ */
+
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/skbuff.h>
+#include <linux/inet_diag.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+
+#include <net/tcp.h>
+
+static int target_delay = 30;
+static int min_rtt_win = 10;
+
+module_param(target_delay, int, 0644);
+MODULE_PARM_DESC(target_delay, "queueing delay allowed (msec)");
+module_param(min_rtt_win, int, 0644);
+MODULE_PARM_DESC(min_rtt_win, "lifetime of the minimum RTT (sec)");
+
+#define MINRTT_BW_ROUNDS	10	/* rounds a rate estimate is kept */
+#define MINRTT_MIN_CWND		4	/* enough for fast retransmit */
+
+struct minrtt {
+	u32	min_rtt_us;		/* propagation delay estimate */
+	u32	min_rtt_stamp;		/* when min_rtt_us was taken */
+	u32	round_rtt_us;		/* smallest RTT of this round */
+	u32	round_end;		/* snd_nxt when the round started */
+	u32	round_start_us;
+	u32	delivered;		/* packets acked this round */
+	u32	bw;			/* delivery rate, packets/sec */
+	u16	bw_age;			/* rounds since bw was taken */
+	u8	cwnd_limited;		/* this round was not app limited */
+	u8	over_target;		/* last round exceeded target_delay */
+};
+
+static inline u32 minrtt_now_us(void)
+{
+	return (u32)ktime_to_us(ktime_get());
+}
+
+static void minrtt_start_round(struct sock *sk)
+{
+	struct minrtt *ca = inet_csk_ca(sk);
+
+	ca->round_end = tcp_sk(sk)->snd_nxt;
+	ca->round_start_us = minrtt_now_us();
+	ca->round_rtt_us = ~0U;
+	ca->delivered = 0;
+	ca->cwnd_limited = 0;
+}
+
+static void tcp_minrtt_init(struct sock *sk)
+{
+	struct minrtt *ca = inet_csk_ca(sk);
+
+	ca->min_rtt_us = ~0U;
+	ca->min_rtt_stamp = tcp_time_stamp;
+	ca->bw = 0;
+	ca->bw_age = 0;
+	ca->over_target = 0;
+	minrtt_start_round(sk);
+}
+
+/* Packets worth the delivery rate over min RTT plus target_delay */
+static u32 minrtt_target_cwnd(const struct sock *sk)
+{
+	const struct minrtt *ca = inet_csk_ca(sk);
+	u64 cwnd;
+
+	if (!ca->bw || ca->min_rtt_us == ~0U)
+		return tcp_sk(sk)->snd_cwnd;
+
+	cwnd = (u64)ca->bw * (ca->min_rtt_us + target_delay * USEC_PER_MSEC);
+	cwnd = div_u64(cwnd, USEC_PER_SEC);
+	return max_t(u32, min_t(u64, cwnd, tcp_sk(sk)->snd_cwnd_clamp),
+		     MINRTT_MIN_CWND);
+}
+
+static void minrtt_end_round(struct sock *sk)
+{
+	struct minrtt *ca = inet_csk_ca(sk);
+	u32 elapsed = minrtt_now_us() - ca->round_start_us;
+
+	if (elapsed && ca->delivered) {
+		u32 bw = div_u64((u64)ca->delivered * USEC_PER_SEC, elapsed);
+
+		/*
+		 * A lower rate replaces bw only once bw is old, and only
+		 * from a cwnd limited round: app limited rounds understate
+		 * what the path delivers.
+		 */
+		if (bw >= ca->bw ||
+		    (++ca->bw_age > MINRTT_BW_ROUNDS && ca->cwnd_limited)) {
+			ca->bw = bw;
+			ca->bw_age = 0;
+		}
+	}
+
+	if (ca->round_rtt_us != ~0U) {
+		/* A path change may have raised the propagation delay */
+		if ((s32)(tcp_time_stamp - ca->min_rtt_stamp) >
+		    min_rtt_win * HZ) {
+			ca->min_rtt_us = ca->round_rtt_us;
+			ca->min_rtt_stamp = tcp_time_stamp;
+		}
+
+		ca->over_target = ca->round_rtt_us - ca->min_rtt_us >
+				  target_delay * USEC_PER_MSEC;
+	}
+
+	minrtt_start_round(sk);
+}
+
+static void tcp_minrtt_pkts_acked(struct sock *sk, u32 num_acked, s32 rtt_us)
+{
+	struct minrtt *ca = inet_csk_ca(sk);
+
+	ca->delivered += num_acked;
+
+	if (rtt_us > 0) {
+		if ((u32)rtt_us < ca->min_rtt_us) {
+			ca->min_rtt_us = rtt_us;
+			ca->min_rtt_stamp = tcp_time_stamp;
+		}
+		ca->round_rtt_us = min_t(u32, ca->round_rtt_us, rtt_us);
+	}
+
+	if (after(tcp_sk(sk)->snd_una, ca->round_end))
+		minrtt_end_round(sk);
+}
+
+static void tcp_minrtt_cong_avoid(struct sock *sk, u32 ack, u32 in_flight)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct minrtt *ca = inet_csk_ca(sk);
+
+	if (ca->over_target) {
+		u32 target = minrtt_target_cwnd(sk);
+
+		ca->over_target = 0;
+		if (tp->snd_cwnd > target)
+			tp->snd_cwnd = target;
+		tp->snd_ssthresh = tp->snd_cwnd;
+		return;
+	}
+
+	if (!tcp_is_cwnd_limited(sk, in_flight))
+		return;
+	ca->cwnd_limited = 1;
+
+	if (tp->snd_cwnd <= tp->snd_ssthresh)
+		tcp_slow_start(tp);
+	else
+		tcp_cong_avoid_ai(tp, tp->snd_cwnd);
+}
+
+static u32 tcp_minrtt_ssthresh(struct sock *sk)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+
+	return max3(tp->snd_cwnd >> 1U,
+		    min(minrtt_target_cwnd(sk), tp->snd_cwnd), 2U);
+}
+
+static void tcp_minrtt_cwnd_event(struct sock *sk, enum tcp_ca_event event)
+{
+	/* the idle time would count against the delivery rate */
+	if (event == CA_EVENT_TX_START)
+		minrtt_start_round(sk);
+}
+
+/* Extract info for Tcp socket info provided via netlink. */
+static void tcp_minrtt_info(struct sock *sk, u32 ext, struct sk_buff *skb)
+{
+	const struct minrtt *ca = inet_csk_ca(sk);
+
+	if (ext & (1 << (INET_DIAG_VEGASINFO - 1))) {
+		struct tcpvegas_info info = {
+			.tcpv_enabled = 1,
+			.tcpv_rttcnt = ca->bw,
+			.tcpv_rtt = ca->round_rtt_us,
+			.tcpv_minrtt = ca->min_rtt_us,
+		};
+
+		nla_put(skb, INET_DIAG_VEGASINFO, sizeof(info), &info);
+	}
+}
+
+static struct tcp_congestion_ops tcp_minrtt = {
+	.flags		= TCP_CONG_RTT_STAMP,
+	.init		= tcp_minrtt_init,
+	.ssthresh	= tcp_minrtt_ssthresh,
+	.cong_avoid	= tcp_minrtt_cong_avoid,
+	.min_cwnd	= tcp_reno_min_cwnd,
+	.cwnd_event	= tcp_minrtt_cwnd_event,
+	.pkts_acked	= tcp_minrtt_pkts_acked,
+	.get_info	= tcp_minrtt_info,
+
+	.owner		= THIS_MODULE,
+	.name		= "minrtt",
+};
+
+static int __init tcp_minrtt_register(void)
+{
+	BUILD_BUG_ON(sizeof(struct minrtt) > ICSK_CA_PRIV_SIZE);
+	return tcp_register_congestion_control(&tcp_minrtt);
+}
+
+static void __exit tcp_minrtt_unregister(void)
+{
+	tcp_unregister_congestion_control(&tcp_minrtt);
+}
+
+module_init(tcp_minrtt_register);
+module_exit(tcp_minrtt_unregister);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("TCP MinRTT");
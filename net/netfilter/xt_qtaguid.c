@@ -0,0 +1,618 @@
+/*
+ * Kernel module to account traffic per uid and socket tag
+ *
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * Sockets are tagged from userspace through /proc/net/xt_qtaguid/ctrl:
+ *
+ *   t <fd> <acct_tag> [<uid>]	tag a socket of the calling process
+ *   u <fd>			remove the tag of a socket
+ *   d <acct_tag> <uid>		drop the counters and socket tags of
+ *				acct_tag for uid, or all of them if
+ *				acct_tag is 0
+ *
+ * Each packet seen by the "qtaguid" match is accounted per interface to
+ * the uid owning its socket (acct_tag 0) and, if the socket is tagged,
+ * to the tag as well. Packets without a socket are accounted to uid 0.
+ * The match itself behaves like the owner match, so
+ *
+ *   iptables -A INPUT -m qtaguid
+ *   iptables -A OUTPUT -m qtaguid
+ *
+ * accounts everything. Every evaluation is counted, so use the match
+ * once per direction.
+ *
+ * Incoming packets are matched to their socket with the socket match's
+ * lookup. Counters are per cpu and the tables are RCU protected, so the
+ * packet path only takes a lock when it creates a counter. The counters
+ * are listed by /proc/net/xt_qtaguid/stats in creation order; idx is
+ * stable, so a reader can pick up where it stopped without walking any
+ * sockets.
+ */
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#include <linux/module.h>
+#include <linux/skbuff.h>
+#include <linux/netdevice.h>
+#include <linux/file.h>
+#include <linux/net.h>
+#include <linux/cred.h>
+#include <linux/slab.h>
+#include <linux/jhash.h>
+#include <linux/hash.h>
+#include <linux/rculist.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/u64_stats_sync.h>
+#include <net/sock.h>
+#include <net/tcp_states.h>
+#include <net/net_namespace.h>
+#include <linux/netfilter/x_tables.h>
+#include <linux/netfilter/xt_socket.h>
+#include <linux/netfilter/xt_qtaguid.h>
+
+#if defined(CONFIG_IP6_NF_IPTABLES) || defined(CONFIG_IP6_NF_IPTABLES_MODULE)
+#define XT_QTAGUID_HAVE_IPV6 1
+#endif
+
+#define QTAGUID_HASH_BITS	8
+#define QTAGUID_HASH_SIZE	(1 << QTAGUID_HASH_BITS)
+
+/* Counters beyond this are not created, userspace can pick the tags */
+static unsigned int max_stats = 4096;
+module_param(max_stats, uint, S_IRUGO | S_IWUSR);
+
+#define make_tag(acct_tag, uid)	(((u64)(acct_tag) << 32) | (u32)(uid))
+#define tag_acct(tag)		((u32)((tag) >> 32))
+#define tag_uid(tag)		((u32)(tag))
+
+struct tag_counters {
+	u64 rx_bytes;
+	u64 rx_packets;
+	u64 tx_bytes;
+	u64 tx_packets;
+	struct u64_stats_sync syncp;
+} ____cacheline_aligned_in_smp;
+
+struct tag_stat {
+	struct hlist_node hnode;	/* stat_hash */
+	struct list_head list;		/* stat_list, in creation order */
+	struct rcu_head rcu;
+	unsigned int idx;
+	u64 tag;
+	char ifname[IFNAMSIZ];
+	struct tag_counters counters[0];	/* nr_cpu_ids */
+};
+
+struct sock_tag {
+	struct hlist_node hnode;
+	struct rcu_head rcu;
+	struct sock *sk;		/* holds a reference */
+	u64 tag;
+};
+
+/* Writers to all tables take qtaguid_lock, readers use RCU */
+static DEFINE_SPINLOCK(qtaguid_lock);
+static struct hlist_head stat_hash[QTAGUID_HASH_SIZE];
+static LIST_HEAD(stat_list);
+static unsigned int nr_stats;
+static unsigned int next_idx;
+static struct hlist_head sock_tag_hash[QTAGUID_HASH_SIZE];
+
+static struct proc_dir_entry *qtaguid_proc;
+
+static inline u32 stat_hash_fn(const char *ifname, u64 tag)
+{
+	return jhash(ifname, strlen(ifname), tag_acct(tag) ^ tag_uid(tag)) &
+		(QTAGUID_HASH_SIZE - 1);
+}
+
+static struct tag_stat *tag_stat_lookup(const char *ifname, u64 tag)
+{
+	struct hlist_node *pos;
+	struct tag_stat *ts;
+
+	hlist_for_each_entry_rcu(ts, pos,
+				 &stat_hash[stat_hash_fn(ifname, tag)], hnode)
+		if (ts->tag == tag && !strncmp(ts->ifname, ifname, IFNAMSIZ))
+			return ts;
+	return NULL;
+}
+
+/* Called with BHs disabled */
+static struct tag_stat *tag_stat_create(const char *ifname, u64 tag)
+{
+	struct tag_stat *ts;
+
+	spin_lock(&qtaguid_lock);
+	ts = tag_stat_lookup(ifname, tag);
+	if (ts != NULL || nr_stats >= max_stats)
+		goto out;
+
+	ts = kzalloc(sizeof(*ts) + nr_cpu_ids * sizeof(struct tag_counters),
+		     GFP_ATOMIC);
+	if (ts == NULL)
+		goto out;
+
+	ts->idx = next_idx++;
+	ts->tag = tag;
+	strlcpy(ts->ifname, ifname, IFNAMSIZ);
+	hlist_add_head_rcu(&ts->hnode, &stat_hash[stat_hash_fn(ifname, tag)]);
+	list_add_tail_rcu(&ts->list, &stat_list);
+	nr_stats++;
+out:
+	spin_unlock(&qtaguid_lock);
+	return ts;
+}
+
+static void tag_stat_free_rcu(struct rcu_head *head)
+{
+	kfree(container_of(head, struct tag_stat, rcu));
+}
+
+/* Called with qtaguid_lock held */
+static void tag_stat_remove(struct tag_stat *ts)
+{
+	hlist_del_rcu(&ts->hnode);
+	list_del_rcu(&ts->list);
+	nr_stats--;
+	call_rcu(&ts->rcu, tag_stat_free_rcu);
+}
+
+static void tag_stat_account(const char *ifname, u64 tag, bool rx,
+			     unsigned int len)
+{
+	struct tag_counters *c;
+	struct tag_stat *ts;
+
+	ts = tag_stat_lookup(ifname, tag);
+	if (ts == NULL)
+		ts = tag_stat_create(ifname, tag);
+	if (ts == NULL)
+		return;
+
+	c = &ts->counters[smp_processor_id()];
+	u64_stats_update_begin(&c->syncp);
+	if (rx) {
+		c->rx_bytes += len;
+		c->rx_packets++;
+	} else {
+		c->tx_bytes += len;
+		c->tx_packets++;
+	}
+	u64_stats_update_end(&c->syncp);
+}
+
+static struct sock_tag *sock_tag_lookup(const struct sock *sk)
+{
+	struct hlist_node *pos;
+	struct sock_tag *st;
+
+	hlist_for_each_entry_rcu(st, pos,
+		&sock_tag_hash[hash_ptr((void *)sk, QTAGUID_HASH_BITS)], hnode)
+		if (st->sk == sk)
+			return st;
+	return NULL;
+}
+
+static void sock_tag_free_rcu(struct rcu_head *head)
+{
+	kfree(container_of(head, struct sock_tag, rcu));
+}
+
+/*
+ * Called with qtaguid_lock held. Packets only compare st->sk, so the
+ * reference can go before the grace period ends.
+ */
+static void sock_tag_remove(struct sock_tag *st)
+{
+	hlist_del_rcu(&st->hnode);
+	sock_put(st->sk);
+	call_rcu(&st->rcu, sock_tag_free_rcu);
+}
+
+/* Drop the tags of sockets that have been closed, qtaguid_lock held */
+static void sock_tag_reap(void)
+{
+	struct hlist_node *pos, *n;
+	struct sock_tag *st;
+	int i;
+
+	for (i = 0; i < QTAGUID_HASH_SIZE; i++)
+		hlist_for_each_entry_safe(st, pos, n, &sock_tag_hash[i], hnode)
+			if (sock_flag(st->sk, SOCK_DEAD))
+				sock_tag_remove(st);
+}
+
+static struct sock *
+qtaguid_get_sk(const struct sk_buff *skb, struct xt_action_param *par)
+{
+	switch (par->family) {
+	case NFPROTO_IPV4:
+		return xt_socket_get4_sk(skb, par);
+#ifdef XT_QTAGUID_HAVE_IPV6
+	case NFPROTO_IPV6:
+		return xt_socket_get6_sk(skb, par);
+#endif
+	default:
+		return NULL;
+	}
+}
+
+static bool
+qtaguid_mt(const struct sk_buff *skb, struct xt_action_param *par)
+{
+	const struct xt_qtaguid_match_info *info = par->matchinfo;
+	const struct net_device *dev;
+	struct sock *sk, *lookup_sk = NULL;
+	struct sock_tag *st;
+	bool has_file = false;
+	uid_t uid = 0;
+	gid_t gid = 0;
+	u64 tag;
+	bool rx;
+
+	rx = par->hooknum == NF_INET_PRE_ROUTING ||
+	     par->hooknum == NF_INET_LOCAL_IN;
+	dev = rx ? par->in : par->out;
+
+	sk = skb->sk;
+	if (sk == NULL && rx)
+		sk = lookup_sk = qtaguid_get_sk(skb, par);
+	if (sk != NULL && sk->sk_state == TCP_TIME_WAIT)
+		sk = NULL;
+
+	if (sk != NULL) {
+		read_lock_bh(&sk->sk_callback_lock);
+		if (sk->sk_socket != NULL && sk->sk_socket->file != NULL) {
+			const struct file *filp = sk->sk_socket->file;
+
+			uid = filp->f_cred->fsuid;
+			gid = filp->f_cred->fsgid;
+			has_file = true;
+		}
+		read_unlock_bh(&sk->sk_callback_lock);
+	}
+
+	if (dev != NULL) {
+		rcu_read_lock();
+		st = sk != NULL ? sock_tag_lookup(sk) : NULL;
+		tag = st != NULL ? st->tag : make_tag(0, uid);
+		tag_stat_account(dev->name, make_tag(0, tag_uid(tag)), rx,
+				 skb->len);
+		if (tag_acct(tag))
+			tag_stat_account(dev->name, tag, rx, skb->len);
+		rcu_read_unlock();
+	}
+
+	if (lookup_sk != NULL)
+		xt_socket_put_sk(lookup_sk);
+
+	if (sk == NULL || sk->sk_socket == NULL)
+		return (info->match ^ info->invert) == 0;
+	else if (info->match & info->invert & XT_QTAGUID_SOCKET)
+		/*
+		 * Socket exists but user wanted ! --socket-exists.
+		 * (Single ampersands intended.)
+		 */
+		return false;
+
+	if (!has_file)
+		return ((info->match ^ info->invert) &
+		       (XT_QTAGUID_UID | XT_QTAGUID_GID)) == 0;
+
+	if (info->match & XT_QTAGUID_UID)
+		if ((uid >= info->uid_min && uid <= info->uid_max) ^
+		    !(info->invert & XT_QTAGUID_UID))
+			return false;
+
+	if (info->match & XT_QTAGUID_GID)
+		if ((gid >= info->gid_min && gid <= info->gid_max) ^
+		    !(info->invert & XT_QTAGUID_GID))
+			return false;
+
+	return true;
+}
+
+static int ctrl_tag(int fd, u32 acct_tag, uid_t uid)
+{
+	struct sock_tag *st, *old;
+	struct socket *sock;
+	int err;
+
+	sock = sockfd_lookup(fd, &err);
+	if (sock == NULL)
+		return err;
+
+	st = kmalloc(sizeof(*st), GFP_KERNEL);
+	if (st == NULL) {
+		sockfd_put(sock);
+		return -ENOMEM;
+	}
+	st->sk = sock->sk;
+	st->tag = make_tag(acct_tag, uid);
+	sock_hold(st->sk);
+
+	spin_lock_bh(&qtaguid_lock);
+	sock_tag_reap();
+	old = sock_tag_lookup(st->sk);
+	if (old != NULL)
+		sock_tag_remove(old);
+	hlist_add_head_rcu(&st->hnode,
+		&sock_tag_hash[hash_ptr(st->sk, QTAGUID_HASH_BITS)]);
+	spin_unlock_bh(&qtaguid_lock);
+
+	sockfd_put(sock);
+	return 0;
+}
+
+static int ctrl_untag(int fd)
+{
+	struct sock_tag *st;
+	struct socket *sock;
+	int err;
+
+	sock = sockfd_lookup(fd, &err);
+	if (sock == NULL)
+		return err;
+
+	spin_lock_bh(&qtaguid_lock);
+	sock_tag_reap();
+	st = sock_tag_lookup(sock->sk);
+	if (st != NULL)
+		sock_tag_remove(st);
+	else
+		err = -ENOENT;
+	spin_unlock_bh(&qtaguid_lock);
+
+	sockfd_put(sock);
+	return st != NULL ? 0 : err;
+}
+
+static void ctrl_delete(u32 acct_tag, uid_t uid)
+{
+	struct hlist_node *pos, *n;
+	struct tag_stat *ts, *tmp;
+	struct sock_tag *st;
+	int i;
+
+	spin_lock_bh(&qtaguid_lock);
+	list_for_each_entry_safe(ts, tmp, &stat_list, list)
+		if (tag_uid(ts->tag) == uid &&
+		    (!acct_tag || tag_acct(ts->tag) == acct_tag))
+			tag_stat_remove(ts);
+
+	for (i = 0; i < QTAGUID_HASH_SIZE; i++)
+		hlist_for_each_entry_safe(st, pos, n, &sock_tag_hash[i], hnode)
+			if (tag_uid(st->tag) == uid &&
+			    (!acct_tag || tag_acct(st->tag) == acct_tag))
+				sock_tag_remove(st);
+	spin_unlock_bh(&qtaguid_lock);
+}
+
+static ssize_t
+qtaguid_ctrl_write(struct file *file, const char __user *input,
+		   size_t size, loff_t *loff)
+{
+	char buf[64];
+	char cmd;
+	u32 acct_tag;
+	uid_t uid;
+	int fd, argc, err;
+
+	if (size == 0)
+		return 0;
+	if (size >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, input, size) != 0)
+		return -EFAULT;
+	buf[size] = '\0';
+
+	switch (buf[0]) {
+	case 't':
+		argc = sscanf(buf, "%c %d %u %u", &cmd, &fd, &acct_tag, &uid);
+		if (argc < 3)
+			return -EINVAL;
+		if (argc < 4)
+			uid = current_fsuid();
+		else if (uid != current_fsuid() && !capable(CAP_NET_ADMIN))
+			return -EPERM;
+		err = ctrl_tag(fd, acct_tag, uid);
+		break;
+	case 'u':
+		if (sscanf(buf, "%c %d", &cmd, &fd) != 2)
+			return -EINVAL;
+		err = ctrl_untag(fd);
+		break;
+	case 'd':
+		if (sscanf(buf, "%c %u %u", &cmd, &acct_tag, &uid) != 3)
+			return -EINVAL;
+		if (uid != current_fsuid() && !capable(CAP_NET_ADMIN))
+			return -EPERM;
+		ctrl_delete(acct_tag, uid);
+		err = 0;
+		break;
+	default:
+		pr_info("Need \"t <fd> <tag> [<uid>]\", \"u <fd>\" "
+			"or \"d <tag> <uid>\"\n");
+		return -EINVAL;
+	}
+
+	return err ? err : size;
+}
+
+static const struct file_operations qtaguid_ctrl_fops = {
+	.write   = qtaguid_ctrl_write,
+	.owner   = THIS_MODULE,
+	.llseek  = noop_llseek,
+};
+
+static void *qtaguid_stats_start(struct seq_file *m, loff_t *pos)
+	__acquires(RCU)
+{
+	struct tag_stat *ts;
+	loff_t n = *pos;
+
+	rcu_read_lock();
+	if (n == 0)
+		return SEQ_START_TOKEN;
+	list_for_each_entry_rcu(ts, &stat_list, list)
+		if (--n == 0)
+			return ts;
+	return NULL;
+}
+
+static void *qtaguid_stats_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	struct list_head *next;
+
+	if (v == SEQ_START_TOKEN)
+		next = rcu_dereference(list_next_rcu(&stat_list));
+	else
+		next = rcu_dereference(list_next_rcu(
+				&((struct tag_stat *)v)->list));
+	++*pos;
+	return next == &stat_list ? NULL :
+		list_entry(next, struct tag_stat, list);
+}
+
+static void qtaguid_stats_stop(struct seq_file *m, void *v)
+	__releases(RCU)
+{
+	rcu_read_unlock();
+}
+
+static int qtaguid_stats_show(struct seq_file *m, void *v)
+{
+	const struct tag_stat *ts = v;
+	u64 rx_bytes = 0, rx_packets = 0, tx_bytes = 0, tx_packets = 0;
+	unsigned int cpu;
+
+	if (v == SEQ_START_TOKEN) {
+		seq_puts(m, "idx iface acct_tag uid rx_bytes rx_packets "
+			 "tx_bytes tx_packets\n");
+		return 0;
+	}
+
+	for_each_possible_cpu(cpu) {
+		const struct tag_counters *c = &ts->counters[cpu];
+		u64 rxb, rxp, txb, txp;
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin_bh(&c->syncp);
+			rxb = c->rx_bytes;
+			rxp = c->rx_packets;
+			txb = c->tx_bytes;
+			txp = c->tx_packets;
+		} while (u64_stats_fetch_retry_bh(&c->syncp, start));
+
+		rx_bytes += rxb;
+		rx_packets += rxp;
+		tx_bytes += txb;
+		tx_packets += txp;
+	}
+
+	seq_printf(m, "%u %s 0x%x %u %llu %llu %llu %llu\n", ts->idx,
+		   ts->ifname, tag_acct(ts->tag), tag_uid(ts->tag),
+		   rx_bytes, rx_packets, tx_bytes, tx_packets);
+	return 0;
+}
+
+static const struct seq_operations qtaguid_stats_seq_ops = {
+	.start		= qtaguid_stats_start,
+	.next		= qtaguid_stats_next,
+	.stop		= qtaguid_stats_stop,
+	.show		= qtaguid_stats_show,
+};
+
+static int qtaguid_stats_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &qtaguid_stats_seq_ops);
+}
+
+static const struct file_operations qtaguid_stats_fops = {
+	.open    = qtaguid_stats_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = seq_release,
+	.owner   = THIS_MODULE,
+};
+
+static struct xt_match qtaguid_mt_reg __read_mostly = {
+	.name       = "qtaguid",
+	.revision   = 0,
+	.family     = NFPROTO_UNSPEC,
+	.match      = qtaguid_mt,
+	.matchsize  = sizeof(struct xt_qtaguid_match_info),
+	.hooks      = (1 << NF_INET_PRE_ROUTING) |
+		      (1 << NF_INET_LOCAL_IN) |
+		      (1 << NF_INET_LOCAL_OUT) |
+		      (1 << NF_INET_POST_ROUTING),
+	.me         = THIS_MODULE,
+};
+
+static void qtaguid_flush(void)
+{
+	struct hlist_node *pos, *n;
+	struct tag_stat *ts, *tmp;
+	struct sock_tag *st;
+	int i;
+
+	spin_lock_bh(&qtaguid_lock);
+	list_for_each_entry_safe(ts, tmp, &stat_list, list)
+		tag_stat_remove(ts);
+	for (i = 0; i < QTAGUID_HASH_SIZE; i++)
+		hlist_for_each_entry_safe(st, pos, n, &sock_tag_hash[i], hnode)
+			sock_tag_remove(st);
+	spin_unlock_bh(&qtaguid_lock);
+
+	rcu_barrier();
+}
+
+static int __init qtaguid_mt_init(void)
+{
+	int ret;
+
+	qtaguid_proc = proc_mkdir("xt_qtaguid", init_net.proc_net);
+	if (qtaguid_proc == NULL)
+		return -ENOMEM;
+
+	ret = -ENOMEM;
+	if (!proc_create("ctrl", S_IWUGO, qtaguid_proc, &qtaguid_ctrl_fops))
+		goto err_dir;
+	if (!proc_create("stats", S_IRUGO, qtaguid_proc, &qtaguid_stats_fops))
+		goto err_ctrl;
+
+	ret = xt_register_match(&qtaguid_mt_reg);
+	if (ret < 0)
+		goto err_stats;
+	return 0;
+
+err_stats:
+	remove_proc_entry("stats", qtaguid_proc);
+err_ctrl:
+	remove_proc_entry("ctrl", qtaguid_proc);
+err_dir:
+	proc_net_remove(&init_net, "xt_qtaguid");
+	return ret;
+}
+
+static void __exit qtaguid_mt_exit(void)
+{
+	xt_unregister_match(&qtaguid_mt_reg);
+	remove_proc_entry("ctrl", qtaguid_proc);
+	remove_proc_entry("stats", qtaguid_proc);
+	proc_net_remove(&init_net, "xt_qtaguid");
+	qtaguid_flush();
+}
+
+module_init(qtaguid_mt_init);
+module_exit(qtaguid_mt_exit);
+MODULE_DESCRIPTION("Xtables: per uid and socket tag traffic accounting");
+MODULE_LICENSE("GPL v2");
+MODULE_ALIAS("ipt_qtaguid");
+MODULE_ALIAS("ip6t_qtaguid");
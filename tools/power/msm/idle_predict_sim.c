@@ -0,0 +1,397 @@
+/*
+ * idle_predict_sim.c - replay MSM idle traces through the idle predictor
+ *
+ * Reads msm_idle:msm_idle_exit events, as printed by ftrace:
+ *
+ *   <idle>-0 [001] 123.456789: msm_idle_exit: cpu=1 sleep_us=48211
+ *	predicted_us=48211 idle_us=1987 collapsed=1
+ *
+ * and replays every idle period twice: once choosing the idle mode from
+ * the next timer event only and once from the prediction made by
+ * arch/arm/mach-msm/idle_predict.c. Power collapse is chosen when the
+ * expected idle length reaches the break-even residency (-r). For both
+ * policies it reports the collapses, the collapses interrupted before
+ * break-even and the idle periods long enough to collapse that were
+ * spent in WFI. The measured idle lengths are taken as given, so the
+ * trace can come from a kernel running either policy.
+ *
+ * The prediction code below mirrors idle_predict.c; keep the two in
+ * sync.
+ *
+ * With -t, synthetic traces are replayed instead and the program exits
+ * non-zero if the predictor does not behave as expected on them.
+ *
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#define MAX_CPUS		8
+#define IDLE_PREDICT_SAMPLES	8
+#define IDLE_PREDICT_MAX_US	1000000
+#define IDLE_PREDICT_STDDEV_US	20
+
+static unsigned int min_samples = 3;
+static unsigned int history_ms = 1000;
+static uint32_t residency_us = 1000;
+
+struct idle_predict {
+	uint32_t intervals[IDLE_PREDICT_SAMPLES];
+	unsigned int nr;
+	unsigned int next;
+	int64_t last_us;
+	uint32_t sleep_us;
+	uint32_t predicted_us;
+};
+
+struct policy_stats {
+	unsigned long idle;
+	unsigned long collapsed;
+	unsigned long collapsed_early;
+	unsigned long missed;
+	unsigned long predicted;
+	unsigned long mispredicted;
+};
+
+static struct idle_predict predict[MAX_CPUS];
+static struct policy_stats timer_stats, predict_stats;
+
+static uint32_t idle_predict_typical(struct idle_predict *p)
+{
+	uint32_t limit = UINT32_MAX;
+	uint32_t largest;
+	uint64_t sum, avg, var;
+	unsigned int i, n;
+	int attempt;
+
+	for (attempt = 0; attempt < 2; attempt++) {
+		sum = 0;
+		n = 0;
+		largest = 0;
+		for (i = 0; i < p->nr; i++) {
+			if (p->intervals[i] > limit)
+				continue;
+			sum += p->intervals[i];
+			if (p->intervals[i] > largest)
+				largest = p->intervals[i];
+			n++;
+		}
+		if (!n || n < min_samples)
+			return 0;
+		avg = sum / n;
+
+		var = 0;
+		for (i = 0; i < p->nr; i++) {
+			int64_t d = (int64_t)p->intervals[i] - (int64_t)avg;
+
+			if (p->intervals[i] > limit)
+				continue;
+			var += d * d;
+		}
+		var /= n;
+
+		if (var <= IDLE_PREDICT_STDDEV_US * IDLE_PREDICT_STDDEV_US ||
+		    avg * avg > 36 * var)
+			return (uint32_t)avg;
+
+		limit = largest - 1;
+	}
+
+	return 0;
+}
+
+static uint32_t idle_predict_sleep_us(struct idle_predict *p,
+				      uint32_t sleep_us, int64_t now_us)
+{
+	uint32_t typical;
+
+	p->sleep_us = sleep_us;
+	p->predicted_us = sleep_us;
+
+	if (!p->nr)
+		return sleep_us;
+
+	if (now_us - p->last_us > (int64_t)history_ms * 1000) {
+		p->nr = 0;
+		p->next = 0;
+		return sleep_us;
+	}
+
+	typical = idle_predict_typical(p);
+	if (typical && typical < sleep_us) {
+		p->predicted_us = typical;
+		predict_stats.predicted++;
+	}
+
+	return p->predicted_us;
+}
+
+static void idle_predict_update(struct idle_predict *p, uint32_t idle_us,
+				int64_t now_us)
+{
+	uint32_t slack = p->sleep_us >> 3;
+
+	if (slack < 100)
+		slack = 100;
+
+	if (idle_us + slack >= p->sleep_us) {
+		if (p->predicted_us < p->sleep_us &&
+		    idle_us > 2 * p->predicted_us) {
+			predict_stats.mispredicted++;
+			p->nr = 0;
+			p->next = 0;
+		}
+		return;
+	}
+
+	p->intervals[p->next] = idle_us < IDLE_PREDICT_MAX_US ?
+		idle_us : IDLE_PREDICT_MAX_US;
+	p->next = (p->next + 1) % IDLE_PREDICT_SAMPLES;
+	if (p->nr < IDLE_PREDICT_SAMPLES)
+		p->nr++;
+	p->last_us = now_us;
+}
+
+static void account(struct policy_stats *s, uint32_t expected_us,
+		    uint32_t idle_us)
+{
+	s->idle++;
+	if (expected_us >= residency_us) {
+		s->collapsed++;
+		if (idle_us < residency_us)
+			s->collapsed_early++;
+	} else if (idle_us >= residency_us) {
+		s->missed++;
+	}
+}
+
+/* @now_us is the time the idle period ended */
+static void replay(unsigned int cpu, int64_t now_us, uint32_t sleep_us,
+		   uint32_t idle_us)
+{
+	struct idle_predict *p = &predict[cpu % MAX_CPUS];
+	int64_t entry_us = now_us - idle_us;
+
+	account(&timer_stats, sleep_us, idle_us);
+	account(&predict_stats,
+		idle_predict_sleep_us(p, sleep_us, entry_us), idle_us);
+	idle_predict_update(p, idle_us, now_us);
+}
+
+static void print_stats(const char *name, struct policy_stats *s)
+{
+	printf("%-8s idle %8lu collapsed %8lu early %8lu missed %8lu\n",
+	       name, s->idle, s->collapsed, s->collapsed_early, s->missed);
+}
+
+static void reset(void)
+{
+	memset(predict, 0, sizeof(predict));
+	memset(&timer_stats, 0, sizeof(timer_stats));
+	memset(&predict_stats, 0, sizeof(predict_stats));
+}
+
+static int replay_file(FILE *f)
+{
+	char line[512];
+	unsigned long events = 0;
+
+	while (fgets(line, sizeof(line), f)) {
+		unsigned int cpu, sleep_us, predicted_us, idle_us;
+		unsigned long sec, usec;
+		char *ev, *ts;
+		int collapsed;
+
+		ev = strstr(line, "msm_idle_exit:");
+		if (!ev)
+			continue;
+		if (sscanf(ev, "msm_idle_exit: cpu=%u sleep_us=%u "
+			   "predicted_us=%u idle_us=%u collapsed=%d",
+			   &cpu, &sleep_us, &predicted_us, &idle_us,
+			   &collapsed) != 5)
+			continue;
+
+		/* timestamp is the "sec.usec:" field before the event */
+		*ev = '\0';
+		ts = strrchr(line, ':');
+		if (!ts)
+			continue;
+		*ts = '\0';
+		while (ts > line && ts[-1] != ' ')
+			ts--;
+		if (sscanf(ts, "%lu.%lu", &sec, &usec) != 2)
+			continue;
+
+		replay(cpu, (int64_t)sec * 1000000 + usec, sleep_us, idle_us);
+		events++;
+	}
+
+	if (!events) {
+		fprintf(stderr, "no msm_idle_exit events found\n");
+		return 1;
+	}
+
+	print_stats("timer", &timer_stats);
+	print_stats("predict", &predict_stats);
+	printf("predicted %lu mispredicted %lu\n",
+	       predict_stats.predicted, predict_stats.mispredicted);
+	return 0;
+}
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			fprintf(stderr, "%s:%d: %s failed\n",		\
+				__func__, __LINE__, #cond);		\
+			return 1;					\
+		}							\
+	} while (0)
+
+/* An interrupt every 500us while the next timer is far away */
+static int test_periodic_irq(void)
+{
+	int64_t now = 0;
+	int i;
+
+	reset();
+	for (i = 0; i < 200; i++) {
+		now += 500;
+		replay(0, now, 50000, 490);
+	}
+
+	CHECK(timer_stats.collapsed_early == 200);
+	CHECK(predict_stats.collapsed_early <= min_samples);
+	CHECK(predict_stats.missed == 0);
+	return 0;
+}
+
+/* The interrupts stop: the first long idle drops the history */
+static int test_pattern_ends(void)
+{
+	int64_t now = 0;
+	int i;
+
+	reset();
+	for (i = 0; i < 20; i++) {
+		now += 500;
+		replay(0, now, 50000, 490);
+	}
+	for (i = 0; i < 20; i++) {
+		now += 50000;
+		replay(0, now, 50000, 50000);
+	}
+
+	CHECK(predict_stats.mispredicted == 1);
+	CHECK(predict_stats.missed == 1);
+	CHECK(predict_stats.collapsed ==
+	      timer_stats.collapsed - (20 - min_samples) - 1);
+	return 0;
+}
+
+/* Random interrupt intervals are no pattern: behave like timer only */
+static int test_random_irq(void)
+{
+	int64_t now = 0;
+	uint32_t idle;
+	int i;
+
+	reset();
+	srand(1);
+	for (i = 0; i < 1000; i++) {
+		idle = 100 + rand() % 20000;
+		now += idle;
+		replay(0, now, 30000, idle);
+	}
+
+	CHECK(predict_stats.missed <= timer_stats.idle / 20);
+	return 0;
+}
+
+/* Wakeups older than history_ms are not used */
+static int test_history_expires(void)
+{
+	int64_t now = 0;
+	int i;
+
+	reset();
+	for (i = 0; i < 8; i++) {
+		now += 500;
+		replay(0, now, 50000, 490);
+	}
+	now += ((int64_t)history_ms + 10) * 1000;
+	replay(0, now, 50000, 490);
+
+	CHECK(predict_stats.collapsed ==
+	      timer_stats.collapsed - (8 - min_samples));
+	return 0;
+}
+
+static int run_tests(void)
+{
+	int failed = 0;
+
+	failed |= test_periodic_irq();
+	failed |= test_pattern_ends();
+	failed |= test_random_irq();
+	failed |= test_history_expires();
+
+	printf("%s\n", failed ? "FAIL" : "PASS");
+	return failed;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-r residency_us] [-m min_samples] "
+		"[-h history_ms] [-t] [trace]\n", name);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	int test = 0;
+	FILE *f = stdin;
+	int c, ret;
+
+	while ((c = getopt(argc, argv, "r:m:h:t")) != -1) {
+		switch (c) {
+		case 'r':
+			residency_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			min_samples = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			history_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			test = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (test)
+		return run_tests();
+
+	if (optind < argc) {
+		f = fopen(argv[optind], "r");
+		if (!f) {
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+
+	ret = replay_file(f);
+	if (f != stdin)
+		fclose(f);
+	return ret;
+}
@@ -0,0 +1,137 @@
+#!/bin/sh
+#
+# netem_lib.sh - emulated cellular link between two network namespaces
+#
+# Sourced by the scripts in this directory. The sender lives in
+# namespace $NS_SND (10.199.0.1), the receiver in $NS_RCV (10.199.0.2),
+# connected by a veth pair. The downlink (sender to receiver) is shaped
+# to a rate, one way delay and queue limit; the uplink only adds the
+# same one way delay, so the base RTT is twice the delay.
+#
+# netem takes the rate itself where it supports it; older kernels,
+# including 2.6.38, get a tbf with netem below it instead.
+#
+# Needs root, iproute2 with netem, ping and iperf (version 2).
+#
+# Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 and
+# only version 2 as published by the Free Software Foundation.
+
+NS_SND=netem_snd
+NS_RCV=netem_rcv
+ADDR_SND=10.199.0.1
+ADDR_RCV=10.199.0.2
+
+SYSCTL_SAVED=""
+IPERF_PID=""
+
+die()
+{
+	echo "$0: $*" >&2
+	exit 1
+}
+
+netem_check()
+{
+	[ "$(id -u)" = 0 ] || die "must be run as root"
+	for tool in ip tc ping iperf awk; do
+		command -v $tool >/dev/null 2>&1 || die "$tool not found"
+	done
+}
+
+# netem_sysctl <namespace> <name> <value>
+#
+# Set a sysctl as seen from a namespace; it is restored by
+# netem_cleanup. The tcp sysctls are global on older kernels and per
+# namespace on newer ones, so this covers both.
+netem_sysctl()
+{
+	local path=/proc/sys/$(echo $2 | tr . /)
+	local old
+
+	old=$(ip netns exec $1 cat $path 2>/dev/null) ||
+		die "$2 not available"
+	SYSCTL_SAVED="$SYSCTL_SAVED $1:$path=$(echo $old | tr ' ' ,)"
+	ip netns exec $1 sh -c "echo '$3' > $path" || die "cannot set $2"
+}
+
+netem_cleanup()
+{
+	local s ns path
+
+	[ -n "$IPERF_PID" ] && kill $IPERF_PID 2>/dev/null
+	IPERF_PID=""
+	# newest first, so a sysctl set twice gets its original value
+	for s in $(echo $SYSCTL_SAVED | tr ' ' '\n' | sed -n '1!G;h;$p'); do
+		ns=${s%%:*}
+		path=${s#*:}
+		path=${path%%=*}
+		ip netns exec $ns sh -c \
+			"echo '$(echo ${s#*=} | tr , ' ')' > $path"
+	done
+	SYSCTL_SAVED=""
+	ip netns del $NS_SND 2>/dev/null
+	ip netns del $NS_RCV 2>/dev/null
+}
+
+# netem_setup <one way delay ms> <rate kbit> <queue limit packets>
+netem_setup()
+{
+	local delay=$1 rate=$2 limit=$3
+
+	# left over from an interrupted run
+	ip netns del $NS_SND 2>/dev/null
+	ip netns del $NS_RCV 2>/dev/null
+
+	ip netns add $NS_SND || die "no network namespace support"
+	ip netns add $NS_RCV
+	ip link add veth_snd type veth peer name veth_rcv
+	ip link set veth_snd netns $NS_SND
+	ip link set veth_rcv netns $NS_RCV
+	ip netns exec $NS_SND ip addr add $ADDR_SND/24 dev veth_snd
+	ip netns exec $NS_RCV ip addr add $ADDR_RCV/24 dev veth_rcv
+	ip netns exec $NS_SND ip link set lo up
+	ip netns exec $NS_RCV ip link set lo up
+	ip netns exec $NS_SND ip link set veth_snd up
+	ip netns exec $NS_RCV ip link set veth_rcv up
+
+	# no offloads: the queue has to see wire sized packets
+	ip netns exec $NS_SND ethtool -K veth_snd tso off gso off \
+		>/dev/null 2>&1
+
+	if ! ip netns exec $NS_SND tc qdisc add dev veth_snd root \
+		netem delay ${delay}ms rate ${rate}kbit limit $limit \
+		2>/dev/null; then
+		ip netns exec $NS_SND tc qdisc add dev veth_snd root \
+			handle 1: tbf rate ${rate}kbit burst 3028 \
+			limit $((limit * 1514)) ||
+			die "cannot shape veth_snd"
+		ip netns exec $NS_SND tc qdisc add dev veth_snd \
+			parent 1:1 handle 10: netem delay ${delay}ms \
+			limit $limit
+	fi
+	ip netns exec $NS_RCV tc qdisc add dev veth_rcv root \
+		netem delay ${delay}ms limit 10000 ||
+		die "cannot add netem to veth_rcv"
+}
+
+# ping_summary <ping output file>: print "min avg" RTT in ms
+ping_summary()
+{
+	sed -n 's|.* = \([0-9.]*\)/\([0-9.]*\)/.*|\1 \2|p' $1
+}
+
+# netem_ping <count> <output file>: ping the receiver every 200ms
+netem_ping()
+{
+	ip netns exec $NS_SND ping -n -q -c $1 -i 0.2 $ADDR_RCV > $2 2>&1
+}
+
+netem_iperf_server()
+{
+	ip netns exec $NS_RCV iperf -s >/dev/null 2>&1 &
+	IPERF_PID=$!
+	sleep 1
+}
@@ -0,0 +1,71 @@
+#!/bin/sh
+#
+# tcp_cc_bufferbloat.sh - goodput and queueing delay per congestion control
+#
+# Runs a bulk iperf transfer over an emulated cellular link with a deep
+# queue (see netem_lib.sh), once per congestion control, while pinging
+# the receiver every 200ms. Reports the goodput, the minimum RTT of the
+# idle link and the average ping RTT during the transfer, and the
+# inflation of the latter over the former, which is the queueing delay
+# the transfer caused.
+#
+# usage: tcp_cc_bufferbloat.sh [seconds per run] [algorithms]
+#
+# The algorithms default to "cubic minrtt"; modules are loaded as
+# needed.
+#
+# Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 and
+# only version 2 as published by the Free Software Foundation.
+
+. $(dirname $0)/netem_lib.sh
+
+DURATION=${1:-20}
+ALGS=${2:-"cubic minrtt"}
+
+# one way delay (ms), rate (kbit), queue limit (packets): about two
+# seconds of buffer, as found in front of many cellular links
+DELAY=40
+RATE=5000
+LIMIT=800
+
+netem_check
+trap netem_cleanup EXIT INT TERM
+
+for alg in $ALGS; do
+	grep -qw $alg /proc/sys/net/ipv4/tcp_available_congestion_control ||
+		modprobe -q tcp_$alg ||
+		die "congestion control $alg not available"
+done
+
+printf "%-8s %10s %8s %8s %10s\n" alg "kbit/s" "min(ms)" "avg(ms)" \
+	"inflation"
+for alg in $ALGS; do
+	netem_setup $DELAY $RATE $LIMIT
+	netem_sysctl $NS_SND net.ipv4.tcp_congestion_control $alg
+	netem_sysctl $NS_SND net.ipv4.tcp_wmem "4096 16384 4194304"
+	netem_sysctl $NS_RCV net.ipv4.tcp_rmem "4096 87380 4194304"
+	netem_iperf_server
+
+	netem_ping 10 /tmp/bufferbloat.idle.$$
+	set -- $(ping_summary /tmp/bufferbloat.idle.$$)
+	base=$1
+
+	# leave the first seconds of slow start out of the ping average
+	(sleep 2; netem_ping $(((DURATION - 3) * 5)) \
+		/tmp/bufferbloat.load.$$) &
+	ping_pid=$!
+	kbit=$(ip netns exec $NS_SND iperf -c $ADDR_RCV -t $DURATION -y C |
+		awk -F, 'END { printf "%.0f", $9 / 1000 }')
+	wait $ping_pid
+	set -- $(ping_summary /tmp/bufferbloat.load.$$)
+	avg=$2
+
+	printf "%-8s %10s %8s %8s %10s\n" $alg $kbit $base $avg \
+		$(echo $base $avg | awk '{ printf "%.1f", $2 - $1 }')
+
+	rm -f /tmp/bufferbloat.idle.$$ /tmp/bufferbloat.load.$$
+	netem_cleanup
+done
@@ -0,0 +1,70 @@
+#!/bin/sh
+#
+# tcp_rcvbuf_rampup.sh - time to full throughput per receive auto-tuning
+#
+# Runs a bulk iperf transfer over emulated 3G and LTE links (see
+# netem_lib.sh) once with tcp_moderate_rcvbuf=1 and once with
+# tcp_moderate_rcvbuf=2, and reports for each the time until a half
+# second interval first reaches 90% of the link rate, and the goodput
+# over the whole run. tcp_rmem[2] is raised to 4MB for both so that
+# only the auto-tuning mode limits the window.
+#
+# usage: tcp_rcvbuf_rampup.sh [seconds per run]
+#
+# Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 and
+# only version 2 as published by the Free Software Foundation.
+
+. $(dirname $0)/netem_lib.sh
+
+DURATION=${1:-15}
+
+# name, one way delay (ms), rate (kbit), queue limit (packets)
+PROFILES="3g:75:3000:200 lte:25:20000:500"
+
+# rampup <link rate kbit>: iperf -y C output on stdin
+rampup()
+{
+	awk -F, -v rate=$1 '
+		{ rows[NR] = $0 }
+		# the last line is the summary for the whole run
+		END {
+			full = "-"
+			for (i = 1; i < NR; i++) {
+				split(rows[i], f, ",")
+				split(f[7], t, "-")
+				if (f[9] >= rate * 1000 * 0.9) {
+					full = t[2]
+					break
+				}
+			}
+			split(rows[NR], f, ",")
+			printf "%8s %10.0f\n", full, f[9] / 1000
+		}'
+}
+
+netem_check
+trap netem_cleanup EXIT INT TERM
+
+printf "%-5s %4s %8s %10s\n" link mode "full(s)" "kbit/s"
+for profile in $PROFILES; do
+	IFS=: read name delay rate limit <<-END
+	$profile
+	END
+
+	for mode in 1 2; do
+		netem_setup $delay $rate $limit
+		netem_sysctl $NS_RCV net.ipv4.tcp_rmem "4096 87380 4194304"
+		netem_sysctl $NS_SND net.ipv4.tcp_wmem "4096 16384 4194304"
+		netem_sysctl $NS_RCV net.ipv4.tcp_moderate_rcvbuf $mode
+		netem_iperf_server
+
+		printf "%-5s %4s " $name $mode
+		ip netns exec $NS_SND iperf -c $ADDR_RCV -t $DURATION \
+			-i 0.5 -y C | rampup $rate
+
+		netem_cleanup
+	done
+done